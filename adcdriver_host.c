@@ -6,8 +6,10 @@
  * 
  * This stuff is meant to be an abstraction layer for the A/D.  It deals with
  * A/D specific stuff like the exact A/D commands, provides commands for
- * A/D write, single writeread, and streaming read.  Later it can also handle
- * the double-buffer scheme.
+ * A/D write, single writeread, and streaming read.  It also handles the
+ * double-buffer scheme:  adc_stream_start sets PRU0 acquiring without
+ * a break into two halves of its RAM, and adc_stream_read hands back
+ * one half at a time while the PRU fills the other.
  *
  */
 
@@ -24,6 +26,7 @@
 #include <pruss_intc_mapping.h>
 
 #include "spidriver_host.h"
+#include "pru_spi.h"
 #include "adcdriver_host.h"
 
 #define SPI_PRU	0
@@ -41,6 +44,16 @@
 #define WRITE_GPIOCON_REG 0x06
 #define WRITE_FILTERCON0_REG 0x28
 
+// Values written to the ADC mode reg, and the one it holds now, see
+// adc_set_mode.
+#define ADCMODE_CONTINUOUS 0x0c
+#define ADCMODE_SINGLE 0x1c
+#define ADCMODE_UNKNOWN 0xffffffff
+static uint32_t adcmode = ADCMODE_UNKNOWN;
+
+// Conversions per half of the stream buffer, see adc_stream_start.
+static uint32_t stream_cnt;
+
 // Default values used in computing voltage from A/D code
 #define OFFSET 0x800000
 #define GAIN 0x555555
@@ -82,8 +95,11 @@ float adc_GetVoltage(uint32_t buf) {
 //---------------------------------------------------
 // Configure A/D to run in desired mode.
 void adc_config(void) {
+  // The reset and the register writes all go to the PRU as one
+  // command list, so they run back to back without a handshake each,
+  // and the waits are timed on the PRU instead of with usleep.
+  spi_cmdlist l;
   uint32_t tx_buf[3];
-  uint32_t retval;
 
   // printf("Entered adc_config.....\n");
 
@@ -93,10 +109,14 @@ void adc_config(void) {
   pru1_init();
   usleep(1000);  // let PRU start functioning before doing anything
 
-  // Send reset message using spi_write_cmd 
+  spi_list_init(&l);
+
+  // Reset the A/D.
   // printf("Commanding A/D reset....\n");
-  adc_reset();
-  
+  spi_list_reset(&l);
+  spi_list_delay(&l, 1000);  // Must wait at least 0.5mS after reset.
+  adcmode = ADCMODE_UNKNOWN;
+
   // Configure channel 0 to use +AIN0, -AIN1,
   // and also enable this channel.
   // This is default -- read data only on channel 0.
@@ -105,9 +125,8 @@ void adc_config(void) {
   tx_buf[0] = WRITE_CH0_REG;
   tx_buf[1] = 0x80; // 0x80;
   tx_buf[2] = 0x01; // 0x01;
-  retval |= spi_write_cmd(tx_buf, 3);
-
-  usleep(5);
+  spi_list_write(&l, tx_buf, 3);
+  spi_list_delay(&l, 5);
 
   // Configure channel 1 to use +AIN2, -AIN3,
   // but don't enable this channel.  User must
@@ -117,9 +136,8 @@ void adc_config(void) {
   tx_buf[0] = WRITE_CH1_REG;
   tx_buf[1] = 0x00;
   tx_buf[2] = 0x43;
-  retval |= spi_write_cmd(tx_buf, 3);
-
-  usleep(5);
+  spi_list_write(&l, tx_buf, 3);
+  spi_list_delay(&l, 5);
 
   // Set up config0 reg
   // Rest val 0x1000
@@ -127,18 +145,11 @@ void adc_config(void) {
   tx_buf[0] = WRITE_SETUPCON0_REG;
   tx_buf[1] = 0x13;
   tx_buf[2] = 0x00;
-  retval |= spi_write_cmd(tx_buf, 3);
-
-  usleep(5);
-
-  // Set up ADC mode reg
-  //printf("WRITE_ADCMODE_REG\n");
-  tx_buf[0] = WRITE_ADCMODE_REG;
-  tx_buf[1] = 0x00;
-  tx_buf[2] = 0x0c;  
-  //retval |= spi_write_cmd(tx_buf, 3);
+  spi_list_write(&l, tx_buf, 3);
+  spi_list_delay(&l, 5);
 
-  usleep(5);
+  // The ADC mode reg is left alone here.  adc_set_mode writes it
+  // when a read first needs it.
 
   // Set up interface mode reg
   // Reset val 0x0000
@@ -146,9 +157,8 @@ void adc_config(void) {
   tx_buf[0] = WRITE_IFMODE_REG;
   tx_buf[1] = 0x00;
   tx_buf[2] = 0x00;
-  retval |= spi_write_cmd(tx_buf, 3);
-
-  usleep(5);
+  spi_list_write(&l, tx_buf, 3);
+  spi_list_delay(&l, 5);
 
   // Set up gpio config reg
   // Reset val 0x0800
@@ -156,9 +166,30 @@ void adc_config(void) {
   tx_buf[0] = WRITE_GPIOCON_REG;
   tx_buf[1] = 0x00;  // Turn off SYNC_N feature
   tx_buf[2] = 0x00;
-  retval |= spi_write_cmd(tx_buf, 3);
+  spi_list_write(&l, tx_buf, 3);
 
-  return;  // retval;
+  spi_list_run(&l);
+  return;
+}
+
+
+//----------------------------------------------
+static void adc_set_mode(uint32_t mode) {
+  // Write the ADC mode reg, unless it already holds mode.  Writing
+  // it restarts conversion and the digital filter, so doing it
+  // before every frame costs a round trip and settling time for
+  // nothing.
+  uint32_t tx_buf[3];
+
+  if (mode == adcmode) {
+    return;
+  }
+  //printf("WRITE_ADCMODE_REG\n");
+  tx_buf[0] = WRITE_ADCMODE_REG;
+  tx_buf[1] = 0x00;
+  tx_buf[2] = mode;
+  spi_write_cmd(tx_buf, 3);
+  adcmode = mode;
 }
 
 
@@ -183,42 +214,53 @@ void adc_quit(void) {
 void adc_reset(void) {
   spi_reset_cmd();
   usleep(1000);  // Must wait at least 0.5mS after reset.
+  adcmode = ADCMODE_UNKNOWN;
 }
 
 
 //----------------------------------------------
 void adc_set_chan0(void) {
+  spi_cmdlist l;
   uint32_t tx_buf[3];
 
+  spi_list_init(&l);
+
   // Disable chan1 reg.
   tx_buf[0] = WRITE_CH1_REG;
   tx_buf[1] = 0x00;
   tx_buf[2] = 0x43;
-  spi_write_cmd(tx_buf, 3);
+  spi_list_write(&l, tx_buf, 3);
 
   // Now enable chan0 reg.
   tx_buf[0] = WRITE_CH0_REG;
   tx_buf[1] = 0x80; // 0x80;
   tx_buf[2] = 0x01; // 0x01;
-  spi_write_cmd(tx_buf, 3);
+  spi_list_write(&l, tx_buf, 3);
+
+  spi_list_run(&l);
 }
 
 
 //----------------------------------------------
 void adc_set_chan1(void) {
+  spi_cmdlist l;
   uint32_t tx_buf[3];
-  
+
+  spi_list_init(&l);
+
   // Disable chan0 reg.
   tx_buf[0] = WRITE_CH0_REG;
   tx_buf[1] = 0x00;
   tx_buf[2] = 0x01;
-  spi_write_cmd(tx_buf, 3);
-  
+  spi_list_write(&l, tx_buf, 3);
+
   // Now enable chan1 reg.
   tx_buf[0] = WRITE_CH1_REG;
   tx_buf[1] = 0x80; // 0x80;
   tx_buf[2] = 0x43; // 0x01;
-  spi_write_cmd(tx_buf, 3);
+  spi_list_write(&l, tx_buf, 3);
+
+  spi_list_run(&l);
 } 
 
 
@@ -251,24 +293,29 @@ float adc_read_single(void) {
   // This fcn reads the diff between ch 1 & 0.  It uses the 
   // level on MISO to know when it is valid to read the value
   // in the data reg.
+  spi_cmdlist l;
   uint32_t tx_buf[3];
-  uint32_t rx_buf;
+  int rx;
   float volts;
 
-  // First set up A/D for single conversion mode by writing mode reg.
-  //printf("WRITE_ADCMODE_REG\n");
+  // First set up A/D for single conversion mode by writing mode reg,
+  // then do the read, both in one command list.  The A/D drops back
+  // to standby after the conversion, so the mode write is needed
+  // every time.
+  spi_list_init(&l);
   tx_buf[0] = WRITE_ADCMODE_REG;
   tx_buf[1] = 0x00;
-  tx_buf[2] = 0x1c;
-  spi_write_cmd(tx_buf, 3);
-
+  tx_buf[2] = ADCMODE_SINGLE;
+  spi_list_write(&l, tx_buf, 3);
 
   // Now do read
   tx_buf[0] = READ_DATA_REG;
-  spi_writeread_single(tx_buf, 1, &rx_buf, 3);
+  rx = spi_list_writeread(&l, tx_buf, 1, 3);
+  spi_list_run(&l);
+  adcmode = ADCMODE_UNKNOWN;
 
   // Now convert to float and return
-  volts = adc_GetVoltage(rx_buf);
+  volts = adc_GetVoltage(l.w[rx]);
   return volts;
 }
 
@@ -290,12 +337,9 @@ void adc_read_multiple(uint32_t read_cnt, float *volts) {
     exit(-1);
   }
 
-  // Set up ADC mode reg for continuous conversation
-  //printf("WRITE_ADCMODE_REG\n");
-  tx_buf[0] = WRITE_ADCMODE_REG;
-  tx_buf[1] = 0x00;
-  tx_buf[2] = 0x0c;
-  spi_write_cmd(tx_buf, 3);
+  // Set up ADC mode reg for continuous conversation.  Only the
+  // first frame actually writes it.
+  adc_set_mode(ADCMODE_CONTINUOUS);
 
   tx_buf[0] = READ_DATA_REG;
   spi_writeread_continuous(tx_buf, 1, rx_buf, 3, read_cnt);  
@@ -308,11 +352,109 @@ void adc_read_multiple(uint32_t read_cnt, float *volts) {
 }
 
 
+//---------------------------------------------
+void adc_stream_start(uint32_t half_cnt) {
+  // Start gapless continuous conversion.  PRU0 keeps reading the A/D
+  // into one half of a double buffer while we convert and process
+  // the other, so no samples are lost between frames as long as
+  // each frame is dealt with in less than half_cnt sample periods.
+  // Collect the frames with adc_stream_read, and call
+  // adc_stream_stop before sending the A/D anything else.
+  uint32_t tx_buf[3];
+
+  // Set up ADC mode reg for continuous conversion.
+  adc_set_mode(ADCMODE_CONTINUOUS);
+
+  tx_buf[0] = READ_DATA_REG;
+  if (spi_stream_start(tx_buf, 1, 3, half_cnt) != 0) {
+    printf("Unable to start A/D stream.  Exiting....\n");
+    exit(-1);
+  }
+  stream_cnt = half_cnt;
+}
+
+
+//---------------------------------------------
+int adc_stream_read(float *volts) {
+  // Wait for the next half_cnt samples of the stream and put them
+  // in volts.  Successive calls give back to back samples.  Returns
+  // the number of half buffers lost since the last call because we
+  // weren't back in time, normally 0.
+  uint32_t rx_buf[STREAM_MAXHALF];
+  int nlost;
+  int i;
+
+  nlost = spi_stream_read(rx_buf);
+  for (i=0; i<stream_cnt; i++) {
+    volts[i] = adc_GetVoltage(rx_buf[i]);
+  }
+  return nlost;
+}
+
+
+//---------------------------------------------
+void adc_stream_stop(void) {
+  spi_stream_stop();
+}
+
+
+//---------------------------------------------
+uint32_t adc_ring_start(void) {
+  // Start gapless continuous conversion into the DDR ring.  Like
+  // adc_stream_start, but the buffer is the DDR pool rather than
+  // PRU RAM, so frames can be far longer than 1024 samples and any
+  // length can be read, not just a fixed half.  Returns the ring
+  // length in samples:  a read can't ask for more, and the ring
+  // only holds that much slack for a slow caller.
+  uint32_t tx_buf[3];
+  uint32_t size;
+
+  adc_set_mode(ADCMODE_CONTINUOUS);
+
+  tx_buf[0] = READ_DATA_REG;
+  size = spi_ring_start(tx_buf, 1, 3);
+  if (size == 0) {
+    printf("Unable to start A/D ring.  Exiting....\n");
+    exit(-1);
+  }
+  return size;
+}
+
+
+//---------------------------------------------
+int adc_ring_read(uint32_t read_cnt, float *volts) {
+  // Wait for the next read_cnt samples from the ring and convert
+  // them into volts, straight out of DDR.  Successive calls give
+  // back to back samples.  Returns the number of samples lost since
+  // the last call because the ring was full, normally 0.
+  const volatile uint32_t *buf;
+  uint32_t tail, mask;
+  int nlost;
+  int i;
+
+  nlost = spi_ring_wait(read_cnt);
+  buf = spi_ring_buf(&tail, &mask);
+  for (i=0; i<read_cnt; i++) {
+    volts[i] = adc_GetVoltage(buf[(tail+i) & mask]);
+  }
+  spi_ring_release(read_cnt);
+  return nlost;
+}
+
+
+//---------------------------------------------
+void adc_ring_stop(void) {
+  spi_ring_stop();
+}
+
+
 //============================================================================
 // These are low-level fcns allowing the caller to send any command desired.
 //----------------------------------------------
 void adc_write(uint32_t *tx_buf, int byte_cnt) {
+  // This may well be a mode reg write, so forget the mode we had.
   spi_write_cmd(tx_buf, byte_cnt);
+  adcmode = ADCMODE_UNKNOWN;
 }
 
 
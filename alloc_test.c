@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cblas.h"
+#include <lapacke.h>
+#include <unistd.h>
+
+#include "matrix_utils.h"
+#include "fft.h"
+#include "music.h"
+#include "covariance.h"
+
+// This program checks that the peak search does no heap
+// allocation once its workspaces are set up.  It is linked with
+// --wrap=malloc (and calloc, realloc), so every allocation in the
+// program, BLAS and LAPACK included, goes through the counters
+// below.  Each frame builds a subspace from synthetic tones, which
+// may allocate (LAPACK does), then runs every search main offers
+// with counting switched on:  the multi-level grid both ways, the
+// dense FFT spectrum, Root-MUSIC, Newton refinement and the
+// reference music_sum.  Exits 0 if no frame allocated anything.
+
+// Frame length, snapshot length and search sizes, as in main.
+#define ATEST_NPTS 128
+#define ATEST_L 64
+#define ATEST_NGRID 25
+#define ATEST_LEVELS 5
+#define ATEST_NFFT 4096
+#define ATEST_ROOT_NFFT 512
+#define ATEST_TOL 1.0e-6f
+
+// Most tones per frame.
+#define ATEST_MAXTONES 4
+
+// Allocation counters.  Only bumped while counting is set.
+static int counting = 0;
+static long nalloc = 0;
+
+void *__real_malloc(size_t n);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *p, size_t n);
+
+void *__wrap_malloc(size_t n) {
+  if (counting) {
+    nalloc++;
+  }
+  return __real_malloc(n);
+}
+
+void *__wrap_calloc(size_t n, size_t size) {
+  if (counting) {
+    nalloc++;
+  }
+  return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *p, size_t n) {
+  if (counting) {
+    nalloc++;
+  }
+  return __real_realloc(p, n);
+}
+
+
+//===========================================================
+//-----------------------------------------------------
+void usage(char *progname) {
+  printf("Usage: %s [-n frames] [-K ntones]\n", progname);
+  printf("  -n  number of synthetic frames.  Default 100.\n");
+  printf("  -K  tones per frame, up to %d.  Default 1.\n", ATEST_MAXTONES);
+}
+
+
+//-----------------------------------------------------
+static void make_tones(float *v, int N, int K) {
+  // Fill v with K unit sinusoids at random frequencies and phases
+  // plus a little noise.  Only the code paths matter here, not the
+  // accuracy, so the frequencies may be anywhere.
+  int i, k;
+  float f[ATEST_MAXTONES];
+  float ph[ATEST_MAXTONES];
+
+  for (k = 0; k < K; k++) {
+    f[k] = 0.05f + 0.4f*rand()/(float) RAND_MAX;
+    ph[k] = 2.0f*PI*rand()/(float) RAND_MAX;
+  }
+  for (i = 0; i < N; i++) {
+    v[i] = 0.01f*(rand()/(float) RAND_MAX - 0.5f);
+    for (k = 0; k < K; k++) {
+      v[i] += sinf(2.0f*PI*f[k]*i + ph[k]);
+    }
+  }
+}
+
+
+//-----------------------------------------------------
+static void grid_search(steer_ws *sw, int batched, int mode, float *v, int Mc, float *Pmu) {
+  // The multi-level grid search from main:  evaluate on the grid,
+  // bracket the peak and zoom in.
+  int j, ileft, iright;
+  float fleft = 0.0f;
+  float fright = 0.5f;
+  float df;
+
+  for (j = 0; j < ATEST_LEVELS; j++) {
+    if (batched) {
+      music_grid_batched(sw, mode, fleft, fright, v, Mc, Pmu);
+    } else {
+      music_grid(sw, mode, fleft, fright, v, Mc, Pmu);
+    }
+    find_bracket(ATEST_NGRID, Pmu, &ileft, &iright);
+    df = (fright-fleft)/(ATEST_NGRID-1);
+    fright = fleft + iright*df;
+    fleft = fleft + ileft*df;
+  }
+}
+
+
+//===========================================================
+int main(int argc, char *argv[]) {
+  int opt;
+  int nframes = 100;
+  int K = 1;
+
+  int m = ATEST_L;
+  int psig, mode, nvec;
+  int t, i, k, npk, nev, info;
+  long before, worst;
+  int nbad;
+  hankel_ws hw;
+  fft_plan fp;
+  fft_plan rp;
+  steer_ws sw;
+
+  float v[ATEST_NPTS];
+  float Rxx[ATEST_L*ATEST_L];
+  float U[ATEST_L*ATEST_L];
+  float VT[ATEST_L*ATEST_L];
+  float S[ATEST_L];
+  float superb[ATEST_L];
+  float Es[ATEST_L*2*ATEST_MAXTONES];
+  float Nu[ATEST_L*ATEST_L];
+  float *Vs;
+  float c[ATEST_L];
+  float Pfft[ATEST_NFFT/2+1];
+  float Pmu[ATEST_NGRID];
+  float ipk[ATEST_MAXTONES];
+  float radius, fl, fr;
+
+  // Parse command line.
+  while ((opt = getopt(argc, argv, "n:K:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      nframes = atoi(optarg);
+      break;
+    case 'K':
+      K = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if ((nframes < 1) || (K < 1) || (K > ATEST_MAXTONES)) {
+    usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  psig = 2*K;
+
+  if (hankel_init(&hw, ATEST_NPTS, m, 0) != 0 ||
+      fft_init(&fp, ATEST_NFFT) != 0 ||
+      fft_init(&rp, ATEST_ROOT_NFFT) != 0 ||
+      steer_init(&sw, m, ATEST_NGRID, 0.0f, 0.5f) != 0) {
+    printf("Unable to allocate workspace.  Exiting....\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // Frame 0 is a warm-up, so a BLAS that sets up its buffers on
+  // first use isn't blamed on the search.
+  srand(1);
+  nbad = 0;
+  worst = 0;
+  for (t = 0; t <= nframes; t++) {
+    make_tones(v, ATEST_NPTS, K);
+    hankel_cov(&hw, v, Rxx);
+    symmetrize_upper(m, Rxx);
+    info = LAPACKE_sgesvd(LAPACK_ROW_MAJOR, 'A', 'A',
+                          m, m, Rxx, m, S, U, m, VT, m, superb);
+    if (info != 0) {
+      fprintf(stderr, "Error: sgesvd returned with a non-zero status (info = %d)\n", info);
+      exit(EXIT_FAILURE);
+    }
+    extract_noise_vectors(U, m, m, psig, Nu);
+    extract_signal_vectors(U, m, m, psig, Es);
+
+    before = nalloc;
+    counting = 1;
+    for (mode = MUSIC_EVAL_NOISE; mode <= MUSIC_EVAL_SIGNAL; mode++) {
+      Vs = (mode == MUSIC_EVAL_NOISE) ? Nu : Es;
+      nvec = (mode == MUSIC_EVAL_NOISE) ? m-psig : psig;
+
+      grid_search(&sw, 0, mode, Vs, nvec, Pmu);
+      grid_search(&sw, 1, mode, Vs, nvec, Pmu);
+
+      music_poly(mode, Vs, m, nvec, c);
+      music_spectrum_fft(&fp, c, m, Pfft);
+      npk = spectrum_peaks(Pfft, ATEST_NFFT/2+1, K, (float) ATEST_NFFT/(2*m), ipk);
+
+      music_spectrum_fft(&rp, c, m, Pfft);
+      npk = spectrum_peaks(Pfft, ATEST_ROOT_NFFT/2+1, K, (float) ATEST_ROOT_NFFT/(2*m), ipk);
+      for (k = 0; k < npk; k++) {
+        (void) music_root(c, m, ipk[k]/ATEST_ROOT_NFFT, &radius);
+        fl = (ipk[k] > 1.0f) ? (ipk[k]-1.0f)/ATEST_ROOT_NFFT : 0.0f;
+        fr = (ipk[k] < ATEST_ROOT_NFFT/2-1) ? (ipk[k]+1.0f)/ATEST_ROOT_NFFT : 0.5f;
+        (void) music_refine(c, m, ipk[k]/ATEST_ROOT_NFFT, fl, fr, ATEST_TOL, &nev);
+      }
+
+      for (i = 0; i < ATEST_NGRID; i++) {
+        if (mode == MUSIC_EVAL_NOISE) {
+          Pmu[i] = music_sum(&sw, 0.5f*i/(ATEST_NGRID-1), Vs, m, nvec);
+        } else {
+          Pmu[i] = music_sum_signal(&sw, 0.5f*i/(ATEST_NGRID-1), Vs, m, nvec);
+        }
+      }
+    }
+    counting = 0;
+
+    if ((t > 0) && (nalloc > before)) {
+      nbad++;
+      if (nalloc-before > worst) {
+        worst = nalloc-before;
+      }
+    }
+  }
+
+  printf("%d frames, %d tone(s), npts = %d, L = %d\n", nframes, K, ATEST_NPTS, m);
+  if (nbad > 0) {
+    printf("FAIL:  %d frames allocated, up to %ld times each\n", nbad, worst);
+  } else {
+    printf("PASS:  no allocations in the search\n");
+  }
+
+  hankel_free(&hw);
+  fft_free(&fp);
+  fft_free(&rp);
+  steer_free(&sw);
+  return (nbad > 0) ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cblas.h"
+#include <lapacke.h>
+#include <unistd.h>
+
+#include "matrix_utils.h"
+#include "fft.h"
+#include "music.h"
+#include "covariance.h"
+#include "timer.h"
+
+// This program compares the CPU time and frequency error of the
+// MUSIC, Min-Norm and Pisarenko estimators on synthetic tones in
+// white noise.  Every estimator works from the same decomposition
+// of the same covariance, so the differences are down to the
+// estimator alone.  It doesn't touch the A/D, so it runs on any
+// machine with BLAS and LAPACK.
+
+// Frame length, default (and largest) snapshot length and
+// sampling frequency.  These match the defaults main uses with
+// -K > 1.
+#define BENCH_NPTS 128
+#define BENCH_L 64
+#define BENCH_FSAMP 15625
+
+// Most tones per frame.
+#define BENCH_MAXTONES 4
+
+// Coarse FFT and Newton tolerance (Hz) of the search, as in
+// main's '-m refine'.
+#define BENCH_NFFT 512
+#define BENCH_TOL 0.01f
+
+// Points in the grid used to time single pseudospectrum
+// evaluations.
+#define BENCH_NGRID 25
+
+// An estimate further than BENCH_OUTLIER bins of the snapshot
+// length from the true tone counts as a miss and is left out of
+// the RMS error.
+#define BENCH_OUTLIER 0.5f
+
+// Estimators to compare.  MUSIC is run both ways, so the
+// reference noise sum is in the table too.
+#define NEST 4
+static const char *est_name[NEST] = {"music-noise", "music-signal", "minnorm", "pisarenko"};
+
+//===========================================================
+//-----------------------------------------------------
+void usage(char *progname) {
+  printf("Usage: %s [-n trials] [-K ntones] [-s sigma] [-L len]\n", progname);
+  printf("  -n  number of synthetic frames.  Default 200.\n");
+  printf("  -K  tones per frame, up to %d.  Default 1.\n", BENCH_MAXTONES);
+  printf("  -L  snapshot length, 2*ntones+1 to %d.  Default %d.\n", BENCH_L, BENCH_L);
+  printf("      Pisarenko is only consistent at L = 2*ntones+1.\n");
+  printf("  -s  standard deviation of the added white noise.  The\n");
+  printf("      tones have unit amplitude.  Default 0.1.\n");
+}
+
+
+//-----------------------------------------------------
+static float gauss(void) {
+  // Box-Muller.  Good enough for test noise.
+  float u1 = (rand() + 1.0f)/(RAND_MAX + 2.0f);
+  float u2 = (rand() + 1.0f)/(RAND_MAX + 2.0f);
+  return sqrtf(-2.0f*logf(u1))*cosf(2.0f*PI*u2);
+}
+
+
+//-----------------------------------------------------
+static void make_tones(float *v, int N, int K, float sigma, float *ftrue) {
+  // Fill v with K unit sinusoids at random frequencies plus noise.
+  // The frequencies are kept a few bins apart and away from DC and
+  // Nyquist so every estimator can resolve them at the default
+  // snapshot length.  ftrue comes back in ascending order.
+  int i, k, l, ok;
+  float ph[BENCH_MAXTONES];
+  float sep = 2.0f*BENCH_FSAMP/BENCH_L;
+
+  do {
+    for (k = 0; k < K; k++) {
+      ftrue[k] = (0.05f + 0.4f*rand()/(float) RAND_MAX)*BENCH_FSAMP;
+      ph[k] = 2.0f*PI*rand()/(float) RAND_MAX;
+    }
+    ok = 1;
+    for (k = 0; k < K; k++) {
+      for (l = k+1; l < K; l++) {
+        if (fabsf(ftrue[k]-ftrue[l]) < sep) {
+          ok = 0;
+        }
+      }
+    }
+  } while (!ok);
+  sortf(K, ftrue);
+
+  for (i = 0; i < N; i++) {
+    v[i] = sigma*gauss();
+    for (k = 0; k < K; k++) {
+      v[i] += sinf(2.0f*PI*ftrue[k]*i/BENCH_FSAMP + ph[k]);
+    }
+  }
+}
+
+
+//===========================================================
+int main(int argc, char *argv[]) {
+  int opt;
+  int ntrials = 200;
+  int K = 1;
+  float sigma = 0.1f;
+
+  int m = BENCH_L;
+  int psig;
+  int t, e, k, npk, nvec, ipeak, nev, info;
+  int mode;
+  hankel_ws hw;
+  fft_plan rp;
+  steer_ws sw;
+  struct timespec tstart;
+
+  float v[BENCH_NPTS];
+  float Rxx[BENCH_L*BENCH_L];
+  float U[BENCH_L*BENCH_L];
+  float VT[BENCH_L*BENCH_L];
+  float S[BENCH_L];
+  float superb[BENCH_L];
+  float Es[BENCH_L*2*BENCH_MAXTONES];
+  float Nu[BENCH_L*BENCH_L];
+  float *Vs;
+  float c[BENCH_L];
+  float Pfft[BENCH_NFFT/2+1];
+  float Pmu[BENCH_NGRID];
+  float ipk[BENCH_MAXTONES];
+  float ftrue[BENCH_MAXTONES];
+  float fest[BENCH_MAXTONES];
+  float fl, fr, err;
+
+  // Per estimator totals
+  double tsearch[NEST], tgrid[NEST], sse[NEST];
+  int nhit[NEST], nmiss[NEST];
+
+  // Parse command line.
+  while ((opt = getopt(argc, argv, "n:K:s:L:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      ntrials = atoi(optarg);
+      break;
+    case 'K':
+      K = atoi(optarg);
+      break;
+    case 's':
+      sigma = atof(optarg);
+      break;
+    case 'L':
+      m = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if ((ntrials < 1) || (K < 1) || (K > BENCH_MAXTONES) ||
+      (m < 2*K+1) || (m > BENCH_L)) {
+    usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+  psig = 2*K;
+
+  // With L <= BENCH_L there are at least npts-L+1 = 65 snapshots,
+  // and forward-backward averaging doubles them, so the covariance
+  // has full rank as Pisarenko needs.
+  if (hankel_init(&hw, BENCH_NPTS, m, 1) != 0 ||
+      fft_init(&rp, BENCH_NFFT) != 0 ||
+      steer_init(&sw, m, BENCH_NGRID, 0.0f, 0.5f) != 0) {
+    printf("Unable to allocate workspace.  Exiting....\n");
+    exit(EXIT_FAILURE);
+  }
+
+  for (e = 0; e < NEST; e++) {
+    tsearch[e] = 0.0;
+    tgrid[e] = 0.0;
+    sse[e] = 0.0;
+    nhit[e] = 0;
+    nmiss[e] = 0;
+  }
+
+  srand(1);
+  for (t = 0; t < ntrials; t++) {
+    make_tones(v, BENCH_NPTS, K, sigma, ftrue);
+
+    // One decomposition shared by all estimators.
+    hankel_cov(&hw, v, Rxx);
+    symmetrize_upper(m, Rxx);
+    info = LAPACKE_sgesvd(LAPACK_ROW_MAJOR, 'A', 'A',
+                          m, m, Rxx, m, S, U, m, VT, m, superb);
+    if (info != 0) {
+      fprintf(stderr, "Error: sgesvd returned with a non-zero status (info = %d)\n", info);
+      exit(EXIT_FAILURE);
+    }
+
+    for (e = 0; e < NEST; e++) {
+      // Time everything after the decomposition:  pulling out the
+      // vectors, the coarse FFT spectrum and Newton on each peak.
+      timer_start(&tstart);
+      if (e == 0) {
+        extract_noise_vectors(U, m, m, psig, Nu);
+        Vs = Nu;
+        nvec = m-psig;
+        mode = MUSIC_EVAL_NOISE;
+      } else if (e == 1) {
+        extract_signal_vectors(U, m, m, psig, Es);
+        Vs = Es;
+        nvec = psig;
+        mode = MUSIC_EVAL_SIGNAL;
+      } else if (e == 2) {
+        extract_signal_vectors(U, m, m, psig, Es);
+        minnorm_vector(Es, m, psig, Nu);
+        Vs = Nu;
+        nvec = 1;
+        mode = MUSIC_EVAL_NOISE;
+      } else {
+        extract_noise_vectors(U, m, m, m-1, Nu);
+        Vs = Nu;
+        nvec = 1;
+        mode = MUSIC_EVAL_NOISE;
+      }
+      music_poly(mode, Vs, m, nvec, c);
+      music_spectrum_fft(&rp, c, m, Pfft);
+      npk = spectrum_peaks(Pfft, BENCH_NFFT/2+1, K, (float) BENCH_NFFT/(2*m), ipk);
+      for (k = 0; k < npk; k++) {
+        ipeak = (int) (ipk[k] + 0.5f);
+        fl = (ipeak > 0) ? (float) (ipeak-1)/BENCH_NFFT : 0.0f;
+        fr = (ipeak < BENCH_NFFT/2) ? (float) (ipeak+1)/BENCH_NFFT : 0.5f;
+        fest[k] = music_refine(c, m, (float) ipeak/BENCH_NFFT, fl, fr,
+                               BENCH_TOL/BENCH_FSAMP, &nev)*BENCH_FSAMP;
+      }
+      tsearch[e] += timer_elapsed_us(&tstart);
+
+      // Time a grid of direct evaluations too, since that is where
+      // the O(L) vs O(L*(L-P)) cost per point shows up.
+      timer_start(&tstart);
+      music_grid(&sw, mode, 0.0f, 0.5f, Vs, nvec, Pmu);
+      tgrid[e] += timer_elapsed_us(&tstart);
+
+      // Score.  Missing tones count as misses.
+      sortf(npk, fest);
+      for (k = 0; k < K; k++) {
+        err = (k < npk) ? fest[k]-ftrue[k] : BENCH_FSAMP;
+        if (fabsf(err) > BENCH_OUTLIER*BENCH_FSAMP/m) {
+          nmiss[e]++;
+        } else {
+          sse[e] += err*err;
+          nhit[e]++;
+        }
+      }
+    }
+  }
+
+  printf("%d frames, %d tone(s), npts = %d, L = %d, noise sigma = %g\n",
+         ntrials, K, BENCH_NPTS, m, sigma);
+  printf("%-14s %12s %14s %12s %8s\n", "estimator", "search (us)", "grid (us/pt)", "rms err (Hz)", "misses");
+  for (e = 0; e < NEST; e++) {
+    printf("%-14s %12.2f %14.3f %12.4f %8d\n", est_name[e],
+           tsearch[e]/ntrials, tgrid[e]/(ntrials*BENCH_NGRID),
+           (nhit[e] > 0) ? sqrt(sse[e]/nhit[e]) : 0.0, nmiss[e]);
+  }
+
+  hankel_free(&hw);
+  fft_free(&rp);
+  steer_free(&sw);
+  return 0;
+}
@@ -0,0 +1,308 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "cblas.h"
+
+#include "matrix_utils.h"
+#include "covariance.h"
+
+//===========================================================
+// This file holds the fcns which build the covariance matrix
+// Rxx from the buffer of A/D samples.  Only the upper triangle
+// of Rxx is filled in -- it is symmetric, and the symmetric
+// LAPACK routines only look at one triangle anyway.  Call
+// symmetrize_upper if you need the full matrix.
+
+
+//-----------------------------------------------------
+int hankel_init(hankel_ws *hw, int N, int L, int fb) {
+  // Set up to build an [L, L] covariance from N samples by
+  // averaging over the K = N-L+1 overlapping length-L
+  // subvectors ("snapshots") of the buffer.  If fb is set we also
+  // apply forward-backward averaging.  Returns 0 on success, -1
+  // on bad args or failed malloc.
+  if ((L < 2) || (L > N)) {
+    printf("hankel_init: need 2 <= L <= N, got L = %d, N = %d\n", L, N);
+    return -1;
+  }
+  hw->N = N;
+  hw->L = L;
+  hw->K = N-L+1;
+  hw->fb = fb;
+  hw->H = 0;
+  hw->head = 0;
+  hw->nhops = 0;
+  hw->ring = NULL;
+  hw->Racc = NULL;
+  hw->Rref = NULL;
+  hw->lambda = 0.0f;
+  hw->X = (float*) malloc(hw->K*L*sizeof(float));
+  if (!hw->X) {
+    return -1;
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------
+void hankel_free(hankel_ws *hw) {
+  free(hw->X);
+  free(hw->ring);
+  free(hw->Racc);
+  free(hw->Rref);
+  hw->X = NULL;
+  hw->ring = NULL;
+  hw->Racc = NULL;
+  hw->Rref = NULL;
+}
+
+
+//-----------------------------------------------------
+int hankel_slide_init(hankel_ws *hw, int H, int cov) {
+  // Switch hw to sliding window mode with a hop of H samples.  We
+  // keep the last N samples in a ring, and if cov is set the
+  // running sum X'*X/K in Racc.  Leave cov clear if nothing will
+  // read the covariance, e.g. the rank 1 decomposition, which
+  // works on the window directly.  Start it with hankel_fill, then
+  // feed it H samples at a time with hankel_push.  Returns 0 on
+  // success, -1 on bad args or failed malloc.
+  if ((H < 1) || (H > hw->N)) {
+    printf("hankel_slide_init: need 1 <= H <= N, got H = %d, N = %d\n", H, hw->N);
+    return -1;
+  }
+  hw->H = H;
+  hw->ring = (float*) malloc(2*hw->N*sizeof(float));
+  if (cov) {
+    hw->Racc = (float*) malloc(hw->L*hw->L*sizeof(float));
+    hw->Rref = (float*) malloc(hw->L*hw->L*sizeof(float));
+  }
+  if (!hw->ring || (cov && (!hw->Racc || !hw->Rref))) {
+    hankel_free(hw);
+    return -1;
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------
+int hankel_exp_init(hankel_ws *hw, float lambda) {
+  // Switch hw to exponentially weighted mode.  Each frame passed
+  // to hankel_update is folded into the running covariance
+  //   Racc = lambda*Racc + (1-lambda)*X'*X/K
+  // so older frames are forgotten with time constant
+  // 1/(1-lambda) frames.  Returns 0 on success, -1 on bad args or
+  // failed malloc.
+  if ((lambda <= 0.0f) || (lambda >= 1.0f)) {
+    printf("hankel_exp_init: need 0 < lambda < 1, got %f\n", lambda);
+    return -1;
+  }
+  hw->lambda = lambda;
+  hw->nhops = 0;
+  hw->Racc = (float*) malloc(hw->L*hw->L*sizeof(float));
+  hw->Rref = (float*) malloc(hw->L*hw->L*sizeof(float));
+  if (!hw->Racc || !hw->Rref) {
+    hankel_free(hw);
+    return -1;
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------
+static void hankel_syrk(hankel_ws *hw, const float *v, int k0, int nk, float alpha, float beta, float *R) {
+  // R = alpha*X'*X + beta*R over the nk snapshots of v starting
+  // at k0, upper triangle only.  Copy them into X first, since
+  // BLAS won't accept overlapping rows (lda < L).
+  int i, j;
+  int L = hw->L;
+
+  for (i = 0; i < nk; i++) {
+    for (j = 0; j < L; j++) {
+      hw->X[lindex(nk, L, i, j)] = v[k0+i+j];
+    }
+  }
+  cblas_ssyrk(CblasRowMajor, CblasUpper, CblasTrans,
+              L,               /* Order of R */
+              nk,              /* Number of snapshots */
+              alpha, hw->X, L,
+              beta, R, L);
+}
+
+
+//-----------------------------------------------------
+static void fb_average(int L, float *R) {
+  // Forward-backward averaging replaces R by (R + J*R*J)/2, where J
+  // is the exchange matrix.  For real data this is the same as
+  // adding the time reversed snapshots, and it decorrelates
+  // coherent components and doubles the effective snapshot count.
+  // (J*R*J)(i,j) = R(L-1-i, L-1-j) = R(L-1-j, L-1-i), which is also in
+  // the upper triangle, so we can average in place pairwise.
+  int i, j, ip, jp;
+  float t;
+
+  for (i = 0; i < L; i++) {
+    for (j = i; j < L; j++) {
+      ip = L-1-j;
+      jp = L-1-i;
+      // Visit each pair once.
+      if ((ip < i) || ((ip == i) && (jp < j))) {
+        continue;
+      }
+      t = 0.5f*(R[lindex(L, L, i, j)] + R[lindex(L, L, ip, jp)]);
+      R[lindex(L, L, i, j)] = t;
+      R[lindex(L, L, ip, jp)] = t;
+    }
+  }
+}
+
+
+//-----------------------------------------------------
+void hankel_cov(hankel_ws *hw, const float *v, float *R) {
+  // Fill the upper triangle of R ([L, L], row-major) with
+  //   R = X'*X/K
+  // where X is the [K, L] Hankel data matrix X(k,i) = v[k+i].  This
+  // is one SSYRK call, which only touches the upper triangle, so
+  // there is no need to zero R first.  With K = 1 this is the
+  // original single snapshot v*v'.  If fb is set, apply forward-
+  // backward averaging (see fb_average).
+  //
+  // In sliding window and exponentially weighted modes the sum is
+  // already in Racc, so v is ignored and we just copy it out.
+  int L = hw->L;
+
+  if (hw->Racc) {
+    memcpy(R, hw->Racc, L*L*sizeof(float));
+  } else {
+    hankel_syrk(hw, v, 0, hw->K, 1.0f/hw->K, 0.0f, R);
+  }
+  if (hw->fb) {
+    fb_average(L, R);
+  }
+}
+
+
+//-----------------------------------------------------
+void hankel_fill(hankel_ws *hw, const float *v) {
+  // Start the sliding window with a full buffer of N samples v.
+  // Each sample goes into the ring twice, at n and n+N, so the
+  // window is always contiguous starting at ring[head].
+  int n;
+  int N = hw->N;
+
+  for (n = 0; n < N; n++) {
+    hw->ring[n] = v[n];
+    hw->ring[n+N] = v[n];
+  }
+  hw->head = 0;
+  hw->nhops = 0;
+  if (hw->Racc) {
+    hankel_syrk(hw, hw->ring, 0, hw->K, 1.0f/hw->K, 0.0f, hw->Racc);
+  }
+}
+
+
+//-----------------------------------------------------
+void hankel_push(hankel_ws *hw, const float *x) {
+  // Slide the window on by the H new samples in x and update the
+  // running covariance.  The first H snapshots of the old window
+  // drop out and H new ones come in at the end, so
+  //   Racc += (Xnew'*Xnew - Xold'*Xold)/K
+  // which is two rank-H SSYRK updates, O(H*L^2) instead of the
+  // O(K*L^2) to rebuild.  Roundoff piles up in the running sum, so
+  // every HANKEL_REBUILD hops, or if the hop is not smaller than
+  // the window, we rebuild from scratch instead.  Without Racc
+  // only the ring moves on.
+  int i, p;
+  int N = hw->N;
+  int H = hw->H;
+  int K = hw->K;
+  int cov = (hw->Racc != NULL);
+  int rebuild;
+
+  rebuild = (H >= K) || (++hw->nhops >= HANKEL_REBUILD);
+  if (cov && !rebuild) {
+    hankel_syrk(hw, &hw->ring[hw->head], 0, H, -1.0f/K, 1.0f, hw->Racc);
+  }
+
+  // New samples overwrite the oldest ones.
+  for (i = 0; i < H; i++) {
+    p = (hw->head + i) % N;
+    hw->ring[p] = x[i];
+    hw->ring[p+N] = x[i];
+  }
+  hw->head = (hw->head + H) % N;
+
+  if (!cov) {
+    return;
+  }
+  if (rebuild) {
+    hankel_syrk(hw, &hw->ring[hw->head], 0, K, 1.0f/K, 0.0f, hw->Racc);
+    hw->nhops = 0;
+  } else {
+    hankel_syrk(hw, &hw->ring[hw->head], K-H, H, 1.0f/K, 1.0f, hw->Racc);
+  }
+}
+
+
+//-----------------------------------------------------
+const float *hankel_window(const hankel_ws *hw) {
+  // In sliding window mode, the current N samples, oldest first.
+  return &hw->ring[hw->head];
+}
+
+
+//-----------------------------------------------------
+void hankel_update(hankel_ws *hw, const float *v) {
+  // Fold the N samples v into the exponentially weighted
+  // covariance.  SSYRK does the scaling and the update in one go
+  // via its beta argument.  The first frame just starts the sum.
+  int K = hw->K;
+
+  if (hw->nhops == 0) {
+    hankel_syrk(hw, v, 0, K, 1.0f/K, 0.0f, hw->Racc);
+  } else {
+    hankel_syrk(hw, v, 0, K, (1.0f - hw->lambda)/K, hw->lambda, hw->Racc);
+  }
+  hw->nhops = 1;
+}
+
+
+//-----------------------------------------------------
+void hankel_mark(hankel_ws *hw) {
+  // Remember the running covariance, e.g. when it has just been
+  // decomposed, for hankel_drift to compare against.
+  int i;
+  int L = hw->L;
+
+  for (i = 0; i < L; i++) {
+    memcpy(&hw->Rref[i*L+i], &hw->Racc[i*L+i], (L-i)*sizeof(float));
+  }
+}
+
+
+//-----------------------------------------------------
+float hankel_drift(const hankel_ws *hw) {
+  // Relative change of the running covariance since hankel_mark,
+  // |Racc - Rref|_F/|Rref|_F.  Only the upper triangle is stored,
+  // so count the off diagonal terms twice.  O(L^2), a cheap test
+  // for whether the subspaces can have moved.
+  int i, j;
+  int L = hw->L;
+  float d, w, num, den;
+
+  num = 0.0f;
+  den = 0.0f;
+  for (i = 0; i < L; i++) {
+    for (j = i; j < L; j++) {
+      w = (i == j) ? 1.0f : 2.0f;
+      d = hw->Racc[i*L+j] - hw->Rref[i*L+j];
+      num += w*d*d;
+      den += w*hw->Rref[i*L+j]*hw->Rref[i*L+j];
+    }
+  }
+  if (den <= 0.0f) {
+    return (num > 0.0f) ? INFINITY : 0.0f;
+  }
+  return sqrtf(num/den);
+}
@@ -0,0 +1,90 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "cblas.h"
+#include <lapacke.h>
+
+#include "matrix_utils.h"
+#include "music.h"
+#include "esprit.h"
+
+//===========================================================
+// This file holds the ESPRIT frequency estimator.  Like MUSIC
+// it works from the signal subspace Es, but instead of searching
+// a pseudospectrum it reads the frequencies straight off the
+// shift invariance of Es:  dropping the last row of Es and
+// dropping the first row give two matrices related by
+//   Es2 = Es1*Phi
+// where the eigenvalues of the PxP matrix Phi are exp(+/-j*w).
+// For PSIG = 2 that is a 2x2 problem, so everything after the
+// decomposition costs O(M*P^2).
+
+
+//-----------------------------------------------------
+int esprit(const float *Es, int M, int P, float *freqs) {
+  // Least-squares ESPRIT.  Es is the [M, P] row-major matrix of
+  // signal vectors.  Solves the normal equations
+  //   (Es1'*Es1)*Phi = Es1'*Es2
+  // for Phi, then turns the angles of its eigenvalues into
+  // normalized frequencies.  A real tone gives a conjugate pair,
+  // so we report one frequency per eigenvalue in the upper half
+  // plane, in [0, 0.5].  Returns the number of frequencies put
+  // into freqs, which must hold P/2 floats, and 0 if Phi has no
+  // complex eigenvalues.  Returns -1 if the LAPACK calls fail.
+  int i, n, info;
+  float A[P*P];
+  float B[P*P];
+  float wr[P];
+  float wi[P];
+  int ipiv[P];
+  float phi[4];
+  float tr, det, disc;
+
+  // Es1 is rows 0..M-2 of Es and Es2 is rows 1..M-1.  Both are
+  // [M-1, P] with leading dimension P, so no copying is needed.
+  cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans, P, P, M-1,
+              1.0f, Es, P, Es, P, 0.0f, A, P);
+  cblas_sgemm(CblasRowMajor, CblasTrans, CblasNoTrans, P, P, M-1,
+              1.0f, Es, P, &Es[P], P, 0.0f, B, P);
+
+  if (P == 2) {
+    // Closed form.  Phi = inv(A)*B, then eigenvalues of Phi from
+    // its trace and determinant.
+    det = A[0]*A[3] - A[1]*A[2];
+    if (det == 0.0f) {
+      return 0;
+    }
+    phi[0] = ( A[3]*B[0] - A[1]*B[2])/det;
+    phi[1] = ( A[3]*B[1] - A[1]*B[3])/det;
+    phi[2] = (-A[2]*B[0] + A[0]*B[2])/det;
+    phi[3] = (-A[2]*B[1] + A[0]*B[3])/det;
+    tr = phi[0] + phi[3];
+    det = phi[0]*phi[3] - phi[1]*phi[2];
+    disc = det - 0.25f*tr*tr;
+    if (disc <= 0.0f) {
+      // Real eigenvalues -- no oscillating component.
+      return 0;
+    }
+    freqs[0] = atan2f(sqrtf(disc), 0.5f*tr)/(2*PI);
+    return 1;
+  }
+
+  // General P.  Solve A*Phi = B, Phi overwrites B.
+  info = LAPACKE_sgesv(LAPACK_ROW_MAJOR, P, P, A, P, ipiv, B, P);
+  if (info != 0) {
+    return -1;
+  }
+  info = LAPACKE_sgeev(LAPACK_ROW_MAJOR, 'N', 'N', P, B, P, wr, wi,
+                       NULL, 1, NULL, 1);
+  if (info != 0) {
+    return -1;
+  }
+
+  n = 0;
+  for (i = 0; i < P; i++) {
+    if ((wi[i] > 0.0f) && (n < P/2)) {
+      freqs[n++] = atan2f(wi[i], wr[i])/(2*PI);
+    }
+  }
+  return n;
+}
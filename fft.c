@@ -0,0 +1,155 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "fft.h"
+
+//===========================================================
+// This file holds a small radix-2 FFT.  We only need forward
+// transforms of real data (the MUSIC polynomial coefficients),
+// so the main entry point is fft_real, which packs the n real
+// inputs into an n/2 point complex FFT and untangles the result.
+// Twiddles and the bit reversal table are computed once in
+// fft_init so the transform itself does no allocation and no
+// cos or sin calls.
+
+
+//-----------------------------------------------------
+int fft_init(fft_plan *p, int n) {
+  // Set up plan for real FFTs of length n.  n must be a power
+  // of 2, at least 4.  Returns 0 on success, -1 on failure.
+  int i, j, k, h;
+
+  p->tw_re = NULL;
+  p->tw_im = NULL;
+  p->rev = NULL;
+  p->re = NULL;
+  p->im = NULL;
+  p->x = NULL;
+  p->Xi = NULL;
+
+  if ((n < 4) || (n & (n-1))) {
+    printf("fft_init: n = %d is not a power of 2\n", n);
+    return -1;
+  }
+  h = n/2;
+  p->n = n;
+
+  p->tw_re = (float*) malloc(h*sizeof(float));
+  p->tw_im = (float*) malloc(h*sizeof(float));
+  p->rev = (int*) malloc(h*sizeof(int));
+  p->re = (float*) malloc(h*sizeof(float));
+  p->im = (float*) malloc(h*sizeof(float));
+  p->x = (float*) malloc(n*sizeof(float));
+  p->Xi = (float*) malloc((h+1)*sizeof(float));
+  if (!p->tw_re || !p->tw_im || !p->rev || !p->re || !p->im ||
+      !p->x || !p->Xi) {
+    fft_free(p);
+    return -1;
+  }
+
+  // tw[k] = exp(-j*2*pi*k/n).  The n/2 point complex FFT needs
+  // exp(-j*2*pi*k/(n/2)) = tw[2k].
+  for (k = 0; k < h; k++) {
+    p->tw_re[k] = cos(2*M_PI*k/n);
+    p->tw_im[k] = -sin(2*M_PI*k/n);
+  }
+
+  // Bit reversal permutation for n/2 points.
+  for (i = 0; i < h; i++) {
+    j = 0;
+    for (k = 1; k < h; k <<= 1) {
+      j = (j << 1) | ((i & k) ? 1 : 0);
+    }
+    p->rev[i] = j;
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------
+void fft_free(fft_plan *p) {
+  free(p->tw_re);
+  free(p->tw_im);
+  free(p->rev);
+  free(p->re);
+  free(p->im);
+  free(p->x);
+  free(p->Xi);
+  p->tw_re = p->tw_im = p->re = p->im = p->x = p->Xi = NULL;
+  p->rev = NULL;
+}
+
+
+//-----------------------------------------------------
+void fft_complex(fft_plan *p, float *re, float *im) {
+  // In place forward FFT of the n/2 point complex vector re + j*im.
+  // Iterative radix-2 decimation in time.
+  int h = p->n/2;
+  int i, j, k, len, half, step;
+  float wr, wi, tr, ti;
+
+  for (i = 0; i < h; i++) {
+    j = p->rev[i];
+    if (j > i) {
+      tr = re[i]; re[i] = re[j]; re[j] = tr;
+      ti = im[i]; im[i] = im[j]; im[j] = ti;
+    }
+  }
+
+  for (len = 2; len <= h; len <<= 1) {
+    half = len/2;
+    step = p->n/len;       // index step into tw for this stage
+    for (i = 0; i < h; i += len) {
+      for (k = 0; k < half; k++) {
+        wr = p->tw_re[k*step];
+        wi = p->tw_im[k*step];
+        tr = wr*re[i+k+half] - wi*im[i+k+half];
+        ti = wr*im[i+k+half] + wi*re[i+k+half];
+        re[i+k+half] = re[i+k] - tr;
+        im[i+k+half] = im[i+k] - ti;
+        re[i+k] = re[i+k] + tr;
+        im[i+k] = im[i+k] + ti;
+      }
+    }
+  }
+}
+
+
+//-----------------------------------------------------
+void fft_real(fft_plan *p, const float *x, float *Xr, float *Xi) {
+  // Forward FFT of the n point real vector x.  Since the output is
+  // conjugate symmetric we only return bins 0 .. n/2, so Xr and Xi
+  // must hold n/2+1 elements.
+  // Method:  treat x as n/2 complex points z[m] = x[2m] + j*x[2m+1],
+  // take Z = FFT(z), then
+  //   X[k] = (Z[k] + conj(Z[h-k]))/2 - j*tw[k]*(Z[k] - conj(Z[h-k]))/2
+  int h = p->n/2;
+  int k;
+  float ar, ai, br, bi, er, ei, orr, oi;
+
+  for (k = 0; k < h; k++) {
+    p->re[k] = x[2*k];
+    p->im[k] = x[2*k+1];
+  }
+  fft_complex(p, p->re, p->im);
+
+  // DC and Nyquist bins are purely real.
+  Xr[0] = p->re[0] + p->im[0];
+  Xi[0] = 0.0f;
+  Xr[h] = p->re[0] - p->im[0];
+  Xi[h] = 0.0f;
+
+  for (k = 1; k < h; k++) {
+    ar = p->re[k];
+    ai = p->im[k];
+    br = p->re[h-k];
+    bi = -p->im[h-k];      // conj(Z[h-k])
+    // Even and odd parts
+    er = 0.5f*(ar + br);
+    ei = 0.5f*(ai + bi);
+    orr = 0.5f*(ai - bi);  // -j*(Z[k] - conj(Z[h-k]))/2
+    oi = -0.5f*(ar - br);
+    Xr[k] = er + p->tw_re[k]*orr - p->tw_im[k]*oi;
+    Xi[k] = ei + p->tw_re[k]*oi + p->tw_im[k]*orr;
+  }
+}
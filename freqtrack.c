@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "freqtrack.h"
+
+//===========================================================
+// This file holds the alpha-beta tracker used to seed the peak
+// search from the previous frames.  For a steady tone the
+// prediction error is small, so the search window shrinks to a
+// few Hz and one small grid finds the peak.  If the tone jumps,
+// the caller notices that the window has no peak in it and
+// falls back to a full-band search, then calls freqtrack_reset.
+
+
+//-----------------------------------------------------
+void freqtrack_init(freqtrack_ws *ft, float alpha, float beta) {
+  // Set the filter gains and start out unlocked, so the first
+  // frame does a full-band search.
+  ft->locked = 0;
+  ft->f = 0.0f;
+  ft->df = 0.0f;
+  ft->var = FTRACK_VAR0;
+  ft->pref = 0.0f;
+  ft->alpha = alpha;
+  ft->beta = beta;
+}
+
+
+//-----------------------------------------------------
+void freqtrack_reset(freqtrack_ws *ft, float f, float p) {
+  // (Re)start the track at f, found by a full-band search, where
+  // the pseudospectrum peak was p.  We know nothing about drift
+  // yet, so the window starts wide.
+  ft->locked = 1;
+  ft->f = f;
+  ft->df = 0.0f;
+  ft->var = FTRACK_VAR0;
+  ft->pref = p;
+}
+
+
+//-----------------------------------------------------
+void freqtrack_window(const freqtrack_ws *ft, float fmax, float *fleft, float *fright) {
+  // Predict the frequency in the next frame and return the search
+  // window [fleft, fright] around it, clipped to [0, fmax].
+  float fpred, w;
+
+  fpred = ft->f + ft->df;
+  w = FTRACK_NSIGMA*sqrtf(ft->var);
+  if (w < FTRACK_WMIN) {
+    w = FTRACK_WMIN;
+  } else if (w > FTRACK_WMAX) {
+    w = FTRACK_WMAX;
+  }
+  *fleft = (fpred - w > 0.0f) ? fpred - w : 0.0f;
+  *fright = (fpred + w < fmax) ? fpred + w : fmax;
+}
+
+
+//-----------------------------------------------------
+int freqtrack_update(freqtrack_ws *ft, float f, float p) {
+  // Fold the peak at f with height p, found in the window, into
+  // the track.  If the peak is too low compared with the
+  // reference we have lost the tone:  unlock and return -1 so the
+  // caller does a full-band search.  Otherwise do the standard
+  // alpha-beta update with a time step of one frame and return 0.
+  // The squared prediction error is smoothed to get the window
+  // width, and the peak height to follow slow changes in level.
+  float fpred, r;
+
+  if (p < FTRACK_MINRATIO*ft->pref) {
+    ft->locked = 0;
+    return -1;
+  }
+
+  fpred = ft->f + ft->df;
+  r = f - fpred;
+  ft->f = fpred + ft->alpha*r;
+  ft->df = ft->df + ft->beta*r;
+  ft->var = (1.0f - FTRACK_SMOOTH)*ft->var + FTRACK_SMOOTH*r*r;
+  ft->pref = (1.0f - FTRACK_SMOOTH)*ft->pref + FTRACK_SMOOTH*p;
+  return 0;
+}
@@ -32,6 +32,12 @@ void adc_set_chan1(void);
 // Data acquisition fcns.
 float adc_read_single(void);
 void adc_read_multiple(uint32_t read_cnt, float *volts);
+void adc_stream_start(uint32_t half_cnt);
+int adc_stream_read(float *volts);
+void adc_stream_stop(void);
+uint32_t adc_ring_start(void);
+int adc_ring_read(uint32_t read_cnt, float *volts);
+void adc_ring_stop(void);
 
 //--------------------------------------------------
 // Low level fcns
@@ -0,0 +1,40 @@
+
+#ifndef COVARIANCE_H
+#define COVARIANCE_H
+
+// These fcns build the covariance matrix from A/D samples.
+
+// In sliding window mode, rebuild the running covariance from
+// scratch every HANKEL_REBUILD hops to flush out roundoff.
+#define HANKEL_REBUILD 64
+
+// Workspace for the Hankel (sliding snapshot) covariance.
+typedef struct {
+  int N;             // Number of samples in buffer
+  int L;             // Length of each snapshot = order of Rxx
+  int K;             // Number of snapshots, N-L+1
+  int fb;            // Nonzero to apply forward-backward averaging
+  float *X;          // [K, L] Hankel data matrix
+  int H;             // Hop in sliding window mode, 0 if off
+  int head;          // Index of oldest sample in ring
+  int nhops;         // Hops since Racc was rebuilt, or 0 if empty
+  float *ring;       // [2N] last N samples, each stored twice
+  float *Racc;       // [L, L] running X'*X/K, upper triangle, or NULL
+  float *Rref;       // [L, L] copy of Racc taken by hankel_mark
+  float lambda;      // Forgetting factor in exponential mode
+} hankel_ws;
+
+// Function prototypes
+int hankel_init(hankel_ws *hw, int N, int L, int fb);
+void hankel_free(hankel_ws *hw);
+void hankel_cov(hankel_ws *hw, const float *v, float *R);
+int hankel_slide_init(hankel_ws *hw, int H, int cov);
+void hankel_fill(hankel_ws *hw, const float *v);
+void hankel_push(hankel_ws *hw, const float *x);
+const float *hankel_window(const hankel_ws *hw);
+int hankel_exp_init(hankel_ws *hw, float lambda);
+void hankel_update(hankel_ws *hw, const float *v);
+void hankel_mark(hankel_ws *hw);
+float hankel_drift(const hankel_ws *hw);
+
+#endif
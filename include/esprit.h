@@ -0,0 +1,11 @@
+
+#ifndef ESPRIT_H
+#define ESPRIT_H
+
+// ESPRIT frequency estimator.  Works on the same signal vectors
+// as the MUSIC code.
+
+// Function prototypes
+int esprit(const float *Es, int M, int P, float *freqs);
+
+#endif
@@ -0,0 +1,27 @@
+
+#ifndef FFT_H
+#define FFT_H
+
+// Small radix-2 FFT used to evaluate the MUSIC pseudospectrum
+// on a dense grid.
+
+// Plan holding precomputed twiddles and scratch for real FFTs
+// of length n.
+typedef struct {
+  int n;             // Length of real transform, power of 2
+  float *tw_re;      // [n/2] cos(2*pi*k/n)
+  float *tw_im;      // [n/2] -sin(2*pi*k/n)
+  int *rev;          // [n/2] bit reversal table
+  float *re;         // [n/2] scratch
+  float *im;         // [n/2] scratch
+  float *x;          // [n] scratch for callers to build the input in
+  float *Xi;         // [n/2+1] scratch for an unwanted imag part
+} fft_plan;
+
+// Function prototypes
+int fft_init(fft_plan *p, int n);
+void fft_free(fft_plan *p);
+void fft_complex(fft_plan *p, float *re, float *im);
+void fft_real(fft_plan *p, const float *x, float *Xr, float *Xi);
+
+#endif
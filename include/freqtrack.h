@@ -0,0 +1,48 @@
+#ifndef FREQTRACK_H
+#define FREQTRACK_H
+
+// Frame to frame tracking of the tone frequency.  An alpha-beta
+// filter predicts where the peak will be in the next frame so the
+// search only has to cover a small window around it.
+
+// Number of grid points in the tracking window.
+#define FTRACK_NGRID 11
+
+// Window half-width is FTRACK_NSIGMA standard deviations of the
+// prediction error, clamped to [FTRACK_WMIN, FTRACK_WMAX] Hz.
+// Right after a full-band search the variance is FTRACK_VAR0.
+#define FTRACK_NSIGMA 4.0f
+#define FTRACK_WMIN 5.0f
+#define FTRACK_WMAX 250.0f
+#define FTRACK_VAR0 (FTRACK_WMAX*FTRACK_WMAX/(FTRACK_NSIGMA*FTRACK_NSIGMA))
+
+// Smoothing gain for the prediction error variance and the
+// reference peak height.
+#define FTRACK_SMOOTH 0.1f
+
+// If the peak of the pseudospectrum over the window falls below
+// FTRACK_MINRATIO times the reference peak height, we drop the
+// track and go back to a full-band search.  Note that the peak
+// height depends a lot on the decomposition -- with the single
+// snapshot covariance it is only about 2/M -- so we compare with
+// the height seen when the track was acquired.
+#define FTRACK_MINRATIO 0.7f
+
+// Tracker state, kept across frames.
+typedef struct {
+  int locked;        // Nonzero if f is worth predicting from
+  float f;           // Filtered frequency, Hz
+  float df;          // Drift, Hz per frame
+  float var;         // Variance of prediction error, Hz^2
+  float pref;        // Reference height of the peak
+  float alpha;       // Filter gain for f
+  float beta;        // Filter gain for df
+} freqtrack_ws;
+
+// Function prototypes
+void freqtrack_init(freqtrack_ws *ft, float alpha, float beta);
+void freqtrack_reset(freqtrack_ws *ft, float f, float p);
+void freqtrack_window(const freqtrack_ws *ft, float fmax, float *fleft, float *fright);
+int freqtrack_update(freqtrack_ws *ft, float f, float p);
+
+#endif
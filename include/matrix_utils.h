@@ -17,7 +17,9 @@ void print_matrix(const float* A, int m, int n);
 void print_matrix_linear(const float* A, int m, int n);
 int lindex(int m, int n, int i, int j);
 void zeros(int m, int n, float *A);
+void symmetrize_upper(int n, float *A);
 void linspace(float x0, float x1, int N, float *v);
 int maxeltf(int N, float *u);
+void sortf(int N, float *u);
 
 #endif
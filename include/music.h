@@ -0,0 +1,75 @@
+
+#ifndef MUSIC_H
+#define MUSIC_H
+
+// These fcns implement the MUSIC pseudospectrum and the
+// helpers used to find its peak.
+
+#define PI 3.1415926535
+
+#include "fft.h"
+
+// Ways to evaluate the pseudospectrum.  Both give the same
+// answer up to roundoff.
+#define MUSIC_EVAL_NOISE  0   // Sum over noise vectors.  Reference impl.
+#define MUSIC_EVAL_SIGNAL 1   // ||e||^2 minus sum over signal vectors.
+
+// Estimators built on the same decomposition.  Min-Norm and
+// Pisarenko each reduce the noise subspace to a single vector, so
+// the pseudospectrum costs O(M) per frequency instead of O(M*(M-P)).
+#define MUSIC_EST_MUSIC     0   // All noise vectors.
+#define MUSIC_EST_MINNORM   1   // Min-norm vector of the noise subspace.
+#define MUSIC_EST_PISARENKO 2   // Eigenvector of the smallest eigenvalue.
+
+// Steering vectors generated by recurrence are renormalized
+// every STEER_RENORM elements.
+#define STEER_RENORM 32
+
+// Preallocated workspace holding steering vectors
+// e = cos(2*pi*f*i) + j*sin(2*pi*f*i).  A grid of N steering
+// vectors is stored as a [2N, M] matrix, real parts in rows 0..N-1
+// and imag parts in rows N..2N-1, so it can be handed straight to
+// SGEMM.  The first-level grid of the peak search never changes, so
+// its steering vectors are tabulated once in tab.
+typedef struct {
+  int M;             // Length of steering vector
+  int N;             // Number of grid points per level
+  float f0, f1;      // Normalized endpoints of first-level grid
+  float *tab;        // [2N, M] first-level table
+  float *grid;       // [2N, M] scratch for refined levels and music_sum
+  float *proj;       // [2N, M] scratch for projections
+} steer_ws;
+
+// Newton polishing of Root-MUSIC roots.  Stop when the step is
+// below ROOT_TOL or after ROOT_MAXITER iterations.  A root further
+// than ROOT_MAXDIST from the unit circle is rejected.
+#define ROOT_MAXITER 20
+#define ROOT_TOL 1.0e-9
+#define ROOT_MAXDIST 0.5
+
+// Most evaluations of the MUSIC denominator music_refine will do
+// before giving up.
+#define REFINE_MAXEVAL 32
+
+// Function prototypes
+void find_bracket(int N, float *u, int *ileft, int *iright);
+void extract_noise_vectors(float *A, int m, int n, int c, float *E);
+void extract_signal_vectors(float *A, int m, int n, int c, float *E);
+void minnorm_vector(const float *Es, int m, int c, float *d);
+int steer_init(steer_ws *ws, int M, int N, float f0, float f1);
+void steer_free(steer_ws *ws);
+float *steer_grid(steer_ws *ws, float f0, float f1);
+void steer_rotate(double c, double s, float *er, float *ei, int M);
+float music_pmu(int mode, const float *er, const float *ei, float *v, int Mr, int Mc);
+void music_grid(steer_ws *ws, int mode, float f0, float f1, float *v, int Mc, float *Pmu);
+void music_grid_batched(steer_ws *ws, int mode, float f0, float f1, float *v, int Mc, float *Pmu);
+void music_poly(int mode, float *v, int Mr, int Mc, float *c);
+void music_spectrum_fft(fft_plan *p, const float *c, int Mr, float *Pmu);
+float spectrum_peak(const float *Pmu, int N);
+int spectrum_peaks(const float *Pmu, int N, int K, float sep, float *idx);
+float music_root(const float *c, int Mr, float f0, float *radius);
+float music_refine(const float *c, int Mr, float f0, float fl, float fr, float tol, int *nevals);
+float music_sum(steer_ws *ws, float f, float *v, int Mr, int Mc);
+float music_sum_signal(steer_ws *ws, float f, float *v, int Mr, int Mc);
+
+#endif
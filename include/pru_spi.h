@@ -14,6 +14,9 @@
 // 0x01 -- SPI write
 // 0x02 -- SPI writeread
 // 0x03 -- SPI reset
+// 0x06 -- SPI stream, see below
+// 0x07 -- SPI stream into the DDR ring, see below
+// 0x08 -- SPI command list, see below
 enum {
   NOP,
   SPI_TEST,
@@ -21,9 +24,66 @@ enum {
   SPI_WRITEREAD_SINGLE,
   SPI_WRITEREAD_CONTINUOUS,
   SPI_RESET,
+  SPI_STREAM,
+  SPI_RING,
+  SPI_CMDLIST,
   SPI_WAIT_COMMAND = 0xff,
 };
 
+// Layout of the SPI_STREAM (ping-pong) command, in words from the
+// start of the communication RAM.  The header is the same as for
+// SPI_WRITEREAD_CONTINUOUS:  flag, tx count, tx words, rx byte
+// count, then the number of conversions per half.  The control
+// words and the two halves of the buffer sit at fixed offsets past
+// the longest header.  The PRU fills half 0, sets STREAM_FULL0 and
+// interrupts, fills half 1, sets STREAM_FULL1 and interrupts, and
+// so on until the host sets STREAM_STOP.  The host clears each
+// FULL word once it has copied that half out.  If the PRU comes
+// round to a half whose FULL word is still set, the host has
+// fallen behind; the PRU counts it in STREAM_OVERRUN and
+// overwrites the half anyway, so the A/D is never held up.
+#define STREAM_STOP     16
+#define STREAM_FULL0    17
+#define STREAM_FULL1    18
+#define STREAM_OVERRUN  19
+#define STREAM_DATA     24
+#define STREAM_MAXHALF  512
+
+// Layout of the DDR ring used by SPI_RING, in words from the start
+// of the external memory pool uio_pruss sets aside.  The command
+// header is flag, tx count, tx words, rx byte count, then the
+// physical address of the ring, and the host stops it through
+// STREAM_STOP as above.  HEAD and TAIL are free-running counts of
+// samples written (by the PRU) and consumed (by the host); SIZE is
+// a power of two, so sample k lives at RING_DATA + (k & (SIZE-1)).
+// Each side only ever writes its own index.  The PRU writes
+// RING_CHUNK samples at a time, and if the host hasn't left room
+// for a whole chunk it keeps the A/D going but throws the chunk
+// away and adds it to RING_OVERRUN, rather than overwrite samples
+// the host hasn't read.
+#define RING_HEAD       0
+#define RING_TAIL       1
+#define RING_SIZE       2
+#define RING_OVERRUN    3
+#define RING_DATA       8
+#define RING_CHUNK      32
+
+// Layout of the SPI_CMDLIST command:  flag, number of entries, then
+// the entries back to back.  Each entry starts with one of the ops
+// below and is followed by its arguments:
+//   LIST_WRITE      tx count, tx words
+//   LIST_WRITEREAD  tx count, tx words, rx byte count, result word
+//   LIST_DELAY      microseconds
+//   LIST_RESET      (none)
+// The PRU runs them back to back and writes each read's result
+// into its result word, then clears the flag once, so a whole
+// configuration costs one handshake.  Tx counts are at most 4 and
+// the whole message at most LIST_MAXWORDS words.
+#define LIST_WRITE      1
+#define LIST_WRITEREAD  2
+#define LIST_DELAY      3
+#define LIST_RESET      4
+#define LIST_MAXWORDS   256
 
 void pru_spi_config0(void);
 void pru_spi_reset(void);
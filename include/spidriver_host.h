@@ -1,6 +1,8 @@
 #ifndef SPIDRIVER_HOST_H
 #define SPIDRIVER_HOST_H
 
+#include "pru_spi.h"
+
 // Global pointer to base of PRU0 RAM.  This is the place
 // where commands and data are communicated between the host
 // ARM processor and the PRU.  The memory buffer is defined in
@@ -14,6 +16,41 @@ static uint32_t *pru0_dataram;
 //#pragma RETAIN(pru1_dataram)
 //static uint32_t *pru1_dataram;
 
+// Ways to access PRU shared RAM.  See pru_set_sync.
+#define PRU_SYNC_MSYNC   0   // msync() around every word.  Old scheme.
+#define PRU_SYNC_BARRIER 1   // Plain loads and stores plus barriers.
+
+// Ways to wait for the PRU to finish a command.  See
+// pru_set_completion.
+#define PRU_DONE_POLL 0      // Spin on the command flag
+#define PRU_DONE_IRQ  1      // Sleep until the PRU interrupts
+
+// Most polls of the command flag, and longest sleep on the PRU
+// interrupt, before a command is deemed to have hung.
+#define PRU_MAXPOLLS 10000000
+#define PRU_IRQ_TIMEOUT_MS 1000
+
+// Running counts of what talking to the PRU has cost, for
+// benchmarking.
+typedef struct {
+  uint32_t syscalls;   // msync(), poll() and read() calls made
+  uint32_t polls;      // Times the command flag was polled
+  uint32_t sleeps;     // Times we slept on the PRU interrupt
+  uint32_t words;      // Words moved to or from PRU RAM
+} pru_stats;
+
+// A list of SPI transactions to hand the PRU in one SPI_CMDLIST
+// command.  Build it with the spi_list_* fcns, then spi_list_run.
+// w holds the entries in the layout given in pru_spi.h, and after
+// the run a read's result is in w[] at the index spi_list_writeread
+// returned.
+typedef struct {
+  uint32_t w[LIST_MAXWORDS-2];
+  int nwords;          // Words of w in use
+  int ncmd;            // Number of entries
+  int nread;           // Number of reads among them
+} spi_cmdlist;
+
 uint8_t pruss_init(void);
 uint8_t pru0_init(void);
 uint8_t pru1_init(void);
@@ -24,6 +61,16 @@ void spi_reset_cmd(void);
 // Low level fcns for internal use.
 uint32_t pru_read_word(uint32_t offset);
 void pru_write_word(uint32_t offset, uint32_t value);
+void pru_read_block(uint32_t offset, uint32_t *dst, int n);
+void pru_write_block(uint32_t offset, const uint32_t *src, int n);
+int pru_wait_flag(uint32_t offset, uint32_t maxpolls);
+void pru_start_cmd(uint32_t flag);
+int pru_wait_done(void);
+int pru_wait_set(uint32_t offset);
+void pru_set_sync(int mode);
+void pru_set_completion(int mode);
+void pru_get_stats(pru_stats *s);
+void pru_clear_stats(void);
 
 // Debug and diagnostic stuff.
 uint32_t pru_test_ram(uint32_t offset, uint32_t value);
@@ -33,6 +80,20 @@ uint32_t pru_test_communication(void);
 uint32_t spi_write_cmd(uint32_t *data, int byte_cnt);
 uint8_t spi_writeread_single(uint32_t *txdata, int txcnt, uint32_t *rxdata, int rxcnt);
 uint8_t spi_writeread_continuous(uint32_t *txdata, int txcnt, uint32_t *rxdata, int rxcnt, int ncnv);
+uint8_t spi_stream_start(uint32_t *txdata, int txcnt, int rxcnt, int nhalf);
+int spi_stream_read(uint32_t *rxdata);
+void spi_stream_stop(void);
+uint32_t spi_ring_start(uint32_t *txdata, int txcnt, int rxcnt);
+int spi_ring_wait(uint32_t n);
+const volatile uint32_t *spi_ring_buf(uint32_t *tail, uint32_t *mask);
+void spi_ring_release(uint32_t n);
+void spi_ring_stop(void);
+void spi_list_init(spi_cmdlist *l);
+int spi_list_write(spi_cmdlist *l, const uint32_t *data, int word_cnt);
+int spi_list_writeread(spi_cmdlist *l, const uint32_t *txdata, int txcnt, int rxcnt);
+int spi_list_delay(spi_cmdlist *l, uint32_t us);
+int spi_list_reset(spi_cmdlist *l);
+void spi_list_run(spi_cmdlist *l);
 
 #endif
 
@@ -0,0 +1,49 @@
+
+#ifndef SUBSPACE_H
+#define SUBSPACE_H
+
+// These fcns compute the signal and noise subspaces of the
+// covariance matrix.
+
+// Ways to decompose the covariance.
+#define DECOMP_SVD   0    // Full LAPACK SVD of Rxx
+#define DECOMP_RANK1 1    // Closed form for Rxx = v*v'
+#define DECOMP_EIG   2    // Partial symmetric eigensolver
+#define DECOMP_TRACK 3    // OPAST tracking, refreshed by DECOMP_EIG
+#define DECOMP_UNITARY 4  // Two half-size real problems, see unitary.c
+#define DECOMP_TOEPLITZ 5 // Lags and Levinson, see toeplitz.c
+
+// How to pick the dimension of the signal subspace.
+#define ORDER_FIXED 0     // Always 2 per tone asked for
+#define ORDER_MDL   1     // Minimum description length
+#define ORDER_AIC   2     // Akaike information criterion
+
+// Diagonal loading, relative to the mean eigenvalue, applied in
+// the model order test so silent input doesn't take log(0).
+#define ORDER_EPS 1.0e-6f
+
+// Workspace for the OPAST subspace tracker.
+typedef struct {
+  int M;             // Snapshot length
+  int P;             // Dimension of tracked subspace
+  float beta;        // Forgetting factor per snapshot
+  float *W;          // [M, P] orthonormal basis of signal subspace
+  float *Z;          // [P, P] inverse correlation of W'*x
+  float *y;          // [P] scratch
+  float *q;          // [P] scratch
+  float *p;          // [M] scratch
+} opast_ws;
+
+// Function prototypes
+void rank1_basis(const float *v, int M, float *U, float *S);
+int eig_subspace(float *R, int M, int P, int signal, float *V, float *w, int *isuppz);
+int opast_init(opast_ws *ow, int M, int P, float beta);
+void opast_free(opast_ws *ow);
+void opast_reset(opast_ws *ow, const float *W, const float *lambda);
+float opast_frame(opast_ws *ow, const float *v, int N);
+float opast_residual(opast_ws *ow, const float *v, int N);
+double logdet_loaded(const float *R, int M, float eps, float *A);
+int model_order(int crit, const float *lam, int nlam, int M, int K,
+                float tr, double logdet, float eps);
+
+#endif
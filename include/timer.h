@@ -0,0 +1,13 @@
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <time.h>
+
+// Helpers for timing stages of the main loop.
+
+// Function prototypes
+void timer_start(struct timespec *t);
+float timer_elapsed_us(const struct timespec *t);
+
+#endif
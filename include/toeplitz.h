@@ -0,0 +1,41 @@
+#ifndef TOEPLITZ_H
+#define TOEPLITZ_H
+
+// Toeplitz covariance path.  Estimates the autocorrelation lags
+// straight from the samples and gets the Pisarenko noise vector
+// from them with Levinson recursions, so Rxx is never formed.
+
+#include "fft.h"
+
+// Use the FFT for the lags when the direct sum would take more
+// than TOEP_FFT_RATIO times the flops of the two FFTs.
+#define TOEP_FFT_RATIO 1.0f
+
+// The smallest eigenvalue search stops when it has bracketed the
+// eigenvalue to within TOEP_TOL relative, or after TOEP_MAXITER
+// Levinson recursions.
+#define TOEP_TOL 1.0e-7
+#define TOEP_MAXITER 60
+
+// Workspace for the Toeplitz path.
+typedef struct {
+  int N;             // Samples per frame
+  int M;             // Number of lags, i.e. order of the covariance
+  int use_fft;       // Nonzero to get the lags by FFT
+  fft_plan p;        // Length >= N+M-1 when use_fft is set
+  float *x;          // [p.n] zero padded frame, then power spectrum
+  float *Xr;         // [p.n/2+1] scratch
+  float *Xi;         // [p.n/2+1] scratch
+  double *r;         // [M] lags in double for the recursions
+  double *a;         // [M] prediction error filter
+  double *b;         // [M] scratch
+  int niter;         // Levinson recursions used by the last call
+} toep_ws;
+
+// Function prototypes
+int toep_init(toep_ws *tw, int N, int M);
+void toep_free(toep_ws *tw);
+void toep_lags(toep_ws *tw, const float *v, float *r);
+float toep_pisarenko(toep_ws *tw, const float *r, float *d);
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef UNITARY_H
+#define UNITARY_H
+
+// Real-valued (unitary) MUSIC.  Splits the forward-backward
+// averaged covariance into two half-size real symmetric problems
+// and searches with a real steering basis.
+
+// Workspace for the unitary decomposition.
+typedef struct {
+  int M;             // Order of Rxx, must be even
+  int h;             // M/2
+  int P;             // Most signal vectors asked for
+  int np;            // Number of symmetric signal vectors found
+  int nm;            // Number of antisymmetric signal vectors found
+  float *Ep;         // [h, h] block for symmetric eigenvectors
+  float *Em;         // [h, h] block for antisymmetric eigenvectors
+  float *Xp;         // [h, P] half of each symmetric signal vector
+  float *Xm;         // [h, P] half of each antisymmetric signal vector
+  float *wp;         // [h] eigenvalues of Ep
+  float *wm;         // [h] eigenvalues of Em
+  int *isuppz;       // [2h] scratch for ssyevr
+  float *c;          // [h] cos half of the real steering basis
+  float *s;          // [h] sin half of the real steering basis
+  float *y;          // [P] scratch
+} unitary_ws;
+
+// Function prototypes
+int unitary_init(unitary_ws *uw, int M, int P);
+void unitary_free(unitary_ws *uw);
+int unitary_subspace(unitary_ws *uw, const float *R, int P, float *Es);
+void unitary_grid(unitary_ws *uw, float f0, float f1, int N, float *Pmu);
+
+#endif
@@ -0,0 +1,34 @@
+#ifndef ZOOM_H
+#define ZOOM_H
+
+// Zoom front end.  Mixes a band of interest down towards DC and
+// decimates, so MUSIC runs on a shorter, lower rate buffer.
+
+// Guard band each side of the band of interest, as a fraction of
+// its width.
+#define ZOOM_GUARD 0.1f
+
+// Length of the decimating FIR in units of the decimation factor.
+#define ZOOM_TAPS 32
+
+// Workspace for the zoom front end.
+typedef struct {
+  int D;             // Decimation factor
+  int ntaps;         // FIR length, ZOOM_TAPS*D+1
+  int nin;           // Raw samples needed per frame
+  int nout;          // Samples produced per frame
+  float fshift;      // Mixing frequency, Hz
+  float *hr;         // [ntaps] real part of bandpass FIR
+  float *hi;         // [ntaps] minus imag part of bandpass FIR
+  float *loc;        // [nin] NCO table, cos(2*pi*fshift*n/fs)
+  float *los;        // [nin] NCO table, -sin(2*pi*fshift*n/fs)
+  float *xr;         // [nin] mixed samples, I channel
+  float *xi;         // [nin] mixed samples, Q channel
+} zoom_ws;
+
+// Function prototypes
+int zoom_init(zoom_ws *zw, float fs, float flo, float fhi, int nout, int maxin);
+void zoom_free(zoom_ws *zw);
+void zoom_run(zoom_ws *zw, const float *x, float *y);
+
+#endif
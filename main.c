@@ -10,16 +10,40 @@
 #include <sys/types.h>
 
 #include "spidriver_host.h"
+#include "pru_spi.h"
 #include "adcdriver_host.h"
 #include "matrix_utils.h"
+#include "fft.h"
+#include "music.h"
+#include "esprit.h"
+#include "covariance.h"
+#include "subspace.h"
+#include "timer.h"
+#include "freqtrack.h"
+#include "unitary.h"
+#include "zoom.h"
+#include "toeplitz.h"
 
-#define PI 3.1415926535
-
-// Length of data buffer
+// Default length of data buffer.  This is also the largest
+// covariance matrix we handle, so it sizes the matrices below.
 #define NUMPTS 128
 
-// Number of signal vectors
-#define PSIG 2
+// Largest data buffer the A/D driver can fill in one read from
+// PRU RAM, and the largest frame read from the DDR ring (-R).  The
+// ring must hold a frame plus a chunk; the default 256 kB pool
+// holds 32768 samples.
+#define MAXPTS 1024
+#define MAXRING 16384
+
+// Ways to get samples from the A/D.
+#define ACQ_FRAME  0      // One read per frame, stop-and-go
+#define ACQ_STREAM 1      // Gapless, double buffer in PRU RAM
+#define ACQ_RING   2      // Gapless, ring buffer in DDR
+
+// Most real tones we estimate at once.  Each takes two signal
+// vectors, so the signal subspace has psig = 2*ntones columns.
+#define MAXTONES 4
+#define MAXPSIG (2*MAXTONES)
 
 // Sampling frequency.  Must match the sampling frequency commanded
 // to the A/D.
@@ -29,95 +53,181 @@
 #define MAXRECURSIONS 5
 #define NGRID 25
 
-//===========================================================
-// Utility functions for MUSIC
+// Length of FFT used for the dense pseudospectrum.  Gives
+// NFFT/2+1 points from 0 to FSAMP/2.  Must be a power of 2 and
+// at least 2*NUMPTS.
+#define NFFT 4096
 
-//-----------------------------------------------------
-void find_bracket(int N, float *u, int *ileft, int *iright) {
-  // Given input vector y, this finds the max element,
-  // then returns the indices of the vectors to its
-  // left and right.
+// Ways to find the peak of the pseudospectrum.
+#define SEARCH_GRID 0     // Recursive grid refinement
+#define SEARCH_FFT  1     // One dense FFT pass
+#define SEARCH_ROOT 2     // Root-MUSIC
+#define SEARCH_ESPRIT 3   // ESPRIT, no pseudospectrum at all
+#define SEARCH_REFINE 4   // Coarse FFT, then Newton on the peak
 
-  int i;
+// Subspace tracking.  TRACK_BETA is the forgetting factor applied
+// per snapshot.  A full decomposition is redone every TRACK_REFRESH
+// frames, or sooner if the fraction of energy falling outside the
+// tracked subspace grows by more than TRACK_DRIFT.
+#define TRACK_BETA 0.98f
+#define TRACK_REFRESH 50
+#define TRACK_DRIFT 0.2f
 
-  i = maxeltf(N, u);
-  if (i == 0) {
-    *ileft = 0;
-    *iright = 1;
-  } else if (i == (N-1)) {
-    *ileft = N-2;
-    *iright = N-1;
-  } else {
-    *ileft = i-1;
-    *iright = i+1;
-  }
-  return;
-}
+// With -D, the covariance is only decomposed again early if it has
+// changed by more than COV_DRIFT (relative Frobenius norm) since
+// the last decomposition.
+#define COV_DRIFT 0.1f
+
+// Length of the coarse FFT used to seed Root-MUSIC.  Only needs to
+// land the seed within a bin or so of the root.
+#define ROOT_NFFT 512
 
+// Default tolerance in Hz for '-m refine'.  The Newton iteration
+// stops once its step is smaller than this.
+#define REFINE_TOL 0.01f
 
+// Gains of the alpha-beta filter used by '-w' to predict the
+// frequency from one frame to the next.
+#define FTRACK_ALPHA 0.5f
+#define FTRACK_BETA 0.1f
+
+//===========================================================
 //-----------------------------------------------------
-void extract_noise_vectors(float *A, int m, int n, int c, float *E) {
-  // This fcn takes input matrix A of size mxn.  It extracts the vectors
-  // of A to the right, starting at col c, and puts the extracted
-  // vectors into E.  E has size [m, n-c]
-
-  //printf("Entered extract_noise_vectors, m = %d, n = %d, c = %d\n", m, n, c);
-  int i, j, l;
-  for (i = 0; i < m; i++) {
-    for (j = c; j < n; j++) {
-      // printf("i = %d, j = %d, A[i,j] = %f\n", i, j, MATRIX_ELEMENT(A, m, n, i, j));
-      l = lindex(m, n-c, i, j-c);
-      // printf("lindex(m, n-c, i,j-c) = %d\n", l);
-      E[l] = MATRIX_ELEMENT(A, m, n, i, j);
-    }
-  }
+void usage(char *progname) {
+  printf("Usage: %s [-e noise|signal] [-b] [-m grid|fft|root|esprit|refine] [-l logfile] [-t]\n", progname);
+  printf("       [-d svd|rank1|eig|track|unitary|toeplitz] [-N npts] [-L len] [-F] [-T tol] [-w] [-K ntones]\n");
+  printf("       [-O mdl|aic] [-Z flo:fhi] [-H hop] [-X lambda] [-D nframes]\n");
+  printf("       [-E music|minnorm|pisarenko] [-i] [-S] [-R]\n");
+  printf("  -e  pseudospectrum evaluation.  'signal' (default) uses the\n");
+  printf("      2*ntones signal vectors, 'noise' is the reference sum over\n");
+  printf("      all noise vectors.\n");
+  printf("  -E  estimator.  'music' (default) uses the whole noise\n");
+  printf("      subspace.  'minnorm' uses only its minimum norm vector\n");
+  printf("      and 'pisarenko' only the eigenvector of the smallest\n");
+  printf("      eigenvalue, so each spectrum point costs O(L).\n");
+  printf("      'pisarenko' needs '-d svd' or '-d eig' and a full rank\n");
+  printf("      covariance.  Neither works with '-m esprit'.\n");
+  printf("  -b  evaluate each grid level with one batched SGEMM instead\n");
+  printf("      of per-point dot products.\n");
+  printf("  -m  peak search.  'grid' (default) refines a %d point grid\n", NGRID);
+  printf("      %d times, 'fft' evaluates the whole spectrum on %d\n", MAXRECURSIONS, NFFT/2+1);
+  printf("      points with one FFT, 'root' is Root-MUSIC.  'esprit'\n");
+  printf("      replaces MUSIC with ESPRIT and implies '-e signal'.\n");
+  printf("      'refine' takes the peak of a %d point FFT and polishes\n", ROOT_NFFT);
+  printf("      it with Newton's method on the pseudospectrum.\n");
+  printf("  -l  with '-m fft', append each frame's spectrum to logfile.\n");
+  printf("  -t  print time spent in decomposition and peak search\n");
+  printf("      each frame.\n");
+  printf("  -d  decomposition.  'rank1' (default) uses the closed form\n");
+  printf("      for the single-snapshot covariance v*v', 'svd' runs the\n");
+  printf("      full LAPACK SVD, 'eig' computes only the eigenvectors\n");
+  printf("      needed with the symmetric eigensolver ssyevr, 'track'\n");
+  printf("      updates the signal subspace from each new snapshot\n");
+  printf("      (OPAST) and only runs 'eig' every %d frames or when\n", TRACK_REFRESH);
+  printf("      the subspace drifts.  'track' implies '-e signal'.\n");
+  printf("      'unitary' splits the forward-backward averaged\n");
+  printf("      covariance into two half-size real eigenproblems and\n");
+  printf("      searches the grid with a real steering basis.  It\n");
+  printf("      needs L even and implies '-F' and '-e signal'.\n");
+  printf("      'toeplitz' never forms Rxx.  It estimates L\n");
+  printf("      autocorrelation lags from the frame and finds the\n");
+  printf("      Pisarenko vector with Levinson recursions, so it\n");
+  printf("      implies '-E pisarenko'.  L defaults to 2*ntones+1;\n");
+  printf("      larger L gives Pisarenko spurious peaks.\n");
+  printf("      Not with -H, -X or -O.\n");
+  printf("  -N  number of samples per frame, up to %d (%d with -R).\n", MAXPTS, MAXRING);
+  printf("      Default %d.\n", NUMPTS);
+  printf("  -L  snapshot length, i.e. order of the covariance, up to %d.\n", NUMPTS);
+  printf("      Default is npts, which gives the single snapshot v*v',\n");
+  printf("      or npts/2 when ntones > 1 or with -O.\n");
+  printf("      Smaller L averages the npts-L+1 overlapping snapshots.\n");
+  printf("  -F  apply forward-backward averaging to the covariance.\n");
+  printf("  -T  with '-m refine', stop when the step is below tol Hz.\n");
+  printf("      Default %g Hz.\n", REFINE_TOL);
+  printf("  -w  with '-m grid', track the tone across frames and only\n");
+  printf("      search a %d point window around the predicted\n", FTRACK_NGRID);
+  printf("      frequency.  Falls back to the full band when the\n");
+  printf("      window holds no clear peak.\n");
+  printf("  -K  number of tones to estimate, up to %d.  Default 1.\n", MAXTONES);
+  printf("      With more than one tone the covariance must average\n");
+  printf("      at least 2*ntones snapshots, and the search must be\n");
+  printf("      'fft', 'refine', 'root' or 'esprit'.  Each frame\n");
+  printf("      prints one record with ntones frequencies in\n");
+  printf("      ascending order, 0 for any tone not found.\n");
+  printf("  -O  estimate the number of tones, up to ntones, each frame\n");
+  printf("      from the covariance eigenvalues with MDL or AIC.\n");
+  printf("      Frames with no tone skip the peak search.  Needs\n");
+  printf("      '-d svd' or '-d eig', and implies '-e signal' with eig.\n");
+  printf("  -Z  zoom into the band flo..fhi Hz.  Mixes the band down\n");
+  printf("      and decimates, so the npts samples MUSIC sees span a\n");
+  printf("      longer stretch of input.  Tones must be in the band.\n");
+  printf("  -H  sliding window.  Keep the last npts samples and give\n");
+  printf("      an estimate every hop new samples, updating the\n");
+  printf("      covariance incrementally when the decomposition\n");
+  printf("      needs it.  Not with -Z.\n");
+  printf("  -X  exponentially weighted covariance.  Each frame is\n");
+  printf("      folded into a running covariance with forgetting\n");
+  printf("      factor lambda, 0 < lambda < 1.  Not with -H.\n");
+  printf("  -D  with -H or -X, only decompose every nframes frames,\n");
+  printf("      or sooner if the covariance changes by more than\n");
+  printf("      %g.  Other frames repeat the last estimate.\n", COV_DRIFT);
+  printf("  -i  sleep until the PRU interrupts at the end of each A/D\n");
+  printf("      command instead of spinning on its flag, leaving the\n");
+  printf("      ARM free while the A/D converts.\n");
+  printf("  -S  stream.  The PRU acquires without a break into a double\n");
+  printf("      buffer while each frame is processed, so no samples are\n");
+  printf("      lost between frames.  Each half holds one frame (or one\n");
+  printf("      hop with -H, which must then divide npts), up to %d.\n", STREAM_MAXHALF);
+  printf("  -R  stream into a ring buffer in DDR.  Gapless like -S,\n");
+  printf("      but frames, hops and zoom input blocks may be any\n");
+  printf("      length up to %d samples.\n", MAXRING);
 }
 
 
 //-----------------------------------------------------
-float music_sum(float f, float *v, int Mr, int Mc) {
-  // This performs the sum over noise space vectors.
-  // Since complex numbers are not supported, I split
-  // the computation into two parts, real and imag.
-
-  int i, j;
+// Print one frame's result:  the ntones frequencies in f, or a
+// note that there was no signal.
+void print_record(int ntones, const float *f, int signal) {
+  int i;
 
-  float *er;
-  float *ei;
-  float *vi;
-  float s, tr, ti;
+  if (!signal) {
+    printf("No signal detected\n");
+  } else if (ntones == 1) {
+    printf("Peak frequency found at f = %f Hz\n", f[0]);
+  } else {
+    printf("Peak frequencies found at f =");
+    for (i = 0; i < ntones; i++) {
+      printf(" %f", f[i]);
+    }
+    printf(" Hz\n");
+  }
+}
 
-  // printf("--> Entered music_sum, [row, col] = [%d, %d]\n", Mr, Mc);
 
-  er = (float*) malloc(Mr*sizeof(float));
-  ei = (float*) malloc(Mr*sizeof(float));
-  vi = (float*) malloc(Mr*sizeof(float));
+//-----------------------------------------------------
+// Get the next n samples into v.  With ACQ_STREAM they come from
+// the half of the double buffer the PRU has just filled, and n is
+// the half length.  With ACQ_RING they are the next n in the DDR
+// ring.  Either way we warn if we were too slow and lost some.
+// With ACQ_FRAME it is a one-off read of n samples.
+void read_samples(int acq, uint32_t n, float *v) {
+  int nlost;
 
-  // Create e vector
-  for(i=0; i<Mr; i++) {
-    er[i] = cos(2*PI*i*f);
-    ei[i] = sin(2*PI*i*f);
+  if (acq == ACQ_FRAME) {
+    adc_read_multiple(n, v);
+    return;
   }
-
-  // Compute denominator
-  s = 0;
-  for(i=0; i<Mc; i++) {     // iterate over columns.
-
-    // v is a matrix, so extract noise vector vi as column vector.
-    for(j=0; j<Mr; j++) {   // iterate over rows
-      vi[j] = v[lindex(Mr, Mc, j, i)]; 
+  if (acq == ACQ_STREAM) {
+    nlost = adc_stream_read(v);
+    if (nlost > 0) {
+      printf("Stream overrun, lost %d buffer(s) of samples\n", nlost);
+    }
+  } else {
+    nlost = adc_ring_read(n, v);
+    if (nlost > 0) {
+      printf("Ring overrun, lost %d samples\n", nlost);
     }
-    tr = cblas_sdot(Mr, er, 1, vi, 1);
-    ti = cblas_sdot(Mr, ei, 1, vi, 1);
-    s = s + tr*tr + ti*ti;
   }
-
-  free(er);
-  free(ei);
-  free(vi);
-
-  // Must guard against returning inf or nan.
-  return (1.0f/s);
 }
 
 
@@ -133,38 +243,395 @@ void stopHandler(int sig) {
 // This is the main program.  It runs a loop, takes a buffer
 // of data from the A/D, then uses the MUSIC algorithm to
 // compute the frequency of the input sine wave.
-int main (void)
+int main (int argc, char *argv[])
 {
   // Loop variables
   uint32_t i, j;
 
+  // Command line options
+  int opt;
+  int eval_mode = MUSIC_EVAL_SIGNAL;
+  int estimator = MUSIC_EST_MUSIC;
+  int smode;                 // Eval mode the search uses on Vs
+  int batched = 0;
+  int search = SEARCH_GRID;
+  char *logname = NULL;
+  FILE *logfp = NULL;
+  int timing = 0;
+  int decomp = DECOMP_RANK1;
+  int npts = NUMPTS;
+  int fb = 0;
+  float tol = REFINE_TOL;
+  int windowed = 0;
+  int ntones = 1;
+  int pmax;                  // Most signal vectors, 2*ntones
+  int psig;                  // Signal vectors used this frame
+  int order = ORDER_FIXED;
+  int zoom = 0;
+  int hop = 0;
+  float lambda = 0.0f;
+  int every = 1;             // Decompose every this many frames
+  int irq = 0;               // Wait for the PRU interrupt
+  int acq = ACQ_FRAME;       // How to get samples from the A/D
+  int maxpts;                // Largest read acq allows
+  uint32_t nhalf;            // Samples per stream half
+  uint32_t nring;            // Samples the DDR ring holds
+  int since = 0;             // Frames since last decomposition
+  int have_signal = 0;       // Last decomposition found a signal
+  float flo, fhi;
+
   // Buffers for tx and rx data from A/D registers.
   uint32_t tx_buf[3];
   uint32_t rx_buf[4];
 
   // Used in LAPACK computations
-  int m = NUMPTS;
+  int m = 0;                 // Order of Rxx, set from -L
   int info;
   float superb[NUMPTS-1];
+  int isuppz[2*NUMPTS];
 
   // Measured voltages from A/D
-  float v[NUMPTS];           // Vector of measurements 
+  float v[MAXRING];          // Vector of measurements 
+  float vraw[MAXRING];       // Raw samples when zooming
+  int nraw;                  // Number of raw samples per frame
+  zoom_ws zw;
+  float fs = FSAMP;          // Sample rate MUSIC sees
+  float fshift = 0.0f;       // Add to frequencies MUSIC finds
+  const float *vw;           // Window of samples for this estimate
+  int filled = 0;            // Sliding window has been filled
   float Rxx[NUMPTS*NUMPTS];  // Covariance matrix.
+  hankel_ws hw;              // Workspace for building Rxx
+  toep_ws tz;                // Used on the Toeplitz path
+  float rlag[NUMPTS];        // Autocorrelation lags
+
+  // Used in subspace tracking
+  opast_ws ow;
+  int need_refresh = 1;      // Do a full decomposition this frame
+  int track_frames = 0;      // Frames since last full decomposition
+  float resid, resid0 = 0.0f;  // Energy fraction outside subspace
   float U[NUMPTS * NUMPTS];
   float S[NUMPTS];
   float VT[NUMPTS * NUMPTS];
 
-  float Nu[NUMPTS * (NUMPTS-PSIG)];  // Vector of noises
+  float Nu[NUMPTS * (NUMPTS-2)];     // Vector of noises
+  float Es[NUMPTS * MAXPSIG];        // Vector of signals
+  float *Vs;                         // Points to Nu or Es
+  int nvec;                          // Number of columns in Vs
 
   // Used in finding peak corresponding to dominant frequency
   float f[NGRID];
   float Pmu[NGRID];
   int ileft, iright;
   float fleft, fright, fpeak;
+  float fpk[MAXTONES];       // Peak frequencies, one per tone
+  float ipk[MAXTONES];       // Fractional spectrum indices of peaks
+  int npk;                   // Number of peaks found
+  steer_ws sw;               // Preallocated steering vectors
+  unitary_ws uw;             // Used in real-valued MUSIC
+
+  // Used in windowed tracking search
+  freqtrack_ws ft;
+  steer_ws tw;               // Steering vectors for the window
+  int found;
+
+  // Used in FFT peak search
+  fft_plan fp;
+  float c[NUMPTS];           // MUSIC polynomial coefficients
+  float Pfft[NFFT/2+1];      // Dense pseudospectrum
+
+  // Used in ESPRIT
+  float fesp[MAXTONES];
+
+  // Used in model order selection
+  float lam[MAXPSIG];        // Largest eigenvalues, descending
+  float tr, eps;
+  double logdet;
+  int d;
+
+  // Used in Root-MUSIC
+  fft_plan rp;               // Coarse FFT for seeding root finder
+  float radius;
+
+  // Used in Newton peak refinement
+  int ipeak;
+  int nevals = 0;
+  int nev;
+
+  // Used in timing
+  struct timespec tstart;
+  float tdecomp, tsearch;
 
   // Stuff used with "hit return when ready..." 
   char dummy[8];
 
+  // Parse command line.
+  while ((opt = getopt(argc, argv, "e:E:bm:l:td:N:L:FT:wK:O:Z:H:X:D:iSRh")) != -1) {
+    switch (opt) {
+    case 'e':
+      if (strcmp(optarg, "noise") == 0) {
+        eval_mode = MUSIC_EVAL_NOISE;
+      } else if (strcmp(optarg, "signal") == 0) {
+        eval_mode = MUSIC_EVAL_SIGNAL;
+      } else {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'E':
+      if (strcmp(optarg, "music") == 0) {
+        estimator = MUSIC_EST_MUSIC;
+      } else if (strcmp(optarg, "minnorm") == 0) {
+        estimator = MUSIC_EST_MINNORM;
+      } else if (strcmp(optarg, "pisarenko") == 0) {
+        estimator = MUSIC_EST_PISARENKO;
+      } else {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'b':
+      batched = 1;
+      break;
+    case 'm':
+      if (strcmp(optarg, "grid") == 0) {
+        search = SEARCH_GRID;
+      } else if (strcmp(optarg, "fft") == 0) {
+        search = SEARCH_FFT;
+      } else if (strcmp(optarg, "root") == 0) {
+        search = SEARCH_ROOT;
+      } else if (strcmp(optarg, "esprit") == 0) {
+        search = SEARCH_ESPRIT;
+      } else if (strcmp(optarg, "refine") == 0) {
+        search = SEARCH_REFINE;
+      } else {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'l':
+      logname = optarg;
+      break;
+    case 't':
+      timing = 1;
+      break;
+    case 'd':
+      if (strcmp(optarg, "svd") == 0) {
+        decomp = DECOMP_SVD;
+      } else if (strcmp(optarg, "rank1") == 0) {
+        decomp = DECOMP_RANK1;
+      } else if (strcmp(optarg, "eig") == 0) {
+        decomp = DECOMP_EIG;
+      } else if (strcmp(optarg, "track") == 0) {
+        decomp = DECOMP_TRACK;
+      } else if (strcmp(optarg, "unitary") == 0) {
+        decomp = DECOMP_UNITARY;
+      } else if (strcmp(optarg, "toeplitz") == 0) {
+        decomp = DECOMP_TOEPLITZ;
+      } else {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    case 'N':
+      npts = atoi(optarg);
+      break;
+    case 'L':
+      m = atoi(optarg);
+      break;
+    case 'F':
+      fb = 1;
+      break;
+    case 'T':
+      tol = atof(optarg);
+      break;
+    case 'w':
+      windowed = 1;
+      break;
+    case 'K':
+      ntones = atoi(optarg);
+      break;
+    case 'Z':
+      if (sscanf(optarg, "%f:%f", &flo, &fhi) != 2) {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      zoom = 1;
+      break;
+    case 'H':
+      hop = atoi(optarg);
+      break;
+    case 'X':
+      lambda = atof(optarg);
+      break;
+    case 'D':
+      every = atoi(optarg);
+      break;
+    case 'i':
+      irq = 1;
+      break;
+    case 'S':
+      acq = ACQ_STREAM;
+      break;
+    case 'R':
+      acq = ACQ_RING;
+      break;
+    case 'O':
+      if (strcmp(optarg, "mdl") == 0) {
+        order = ORDER_MDL;
+      } else if (strcmp(optarg, "aic") == 0) {
+        order = ORDER_AIC;
+      } else {
+        usage(argv[0]);
+        exit(EXIT_FAILURE);
+      }
+      break;
+    default:
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // Sanity check sizes.
+  if ((ntones < 1) || (ntones > MAXTONES)) {
+    printf("Need 1 <= ntones <= %d.\n", MAXTONES);
+    exit(EXIT_FAILURE);
+  }
+  pmax = 2*ntones;
+  psig = pmax;
+  if (m == 0) {
+    if (decomp == DECOMP_TOEPLITZ) {
+      m = psig+1;
+    } else {
+      m = ((ntones == 1) && (order == ORDER_FIXED) && (search != SEARCH_ESPRIT)) ?
+          npts : npts/2;
+    }
+  }
+  maxpts = (acq == ACQ_RING) ? MAXRING : MAXPTS;
+  if ((npts < 2) || (npts > maxpts) || (m < psig+1) || (m > NUMPTS) || (m > npts)) {
+    printf("Need npts <= %d and %d <= L <= min(npts, %d).\n", maxpts, psig+1, NUMPTS);
+    exit(EXIT_FAILURE);
+  }
+
+  // A single snapshot only gives a rank 1 covariance, so to see
+  // more than one tone, or to tell how many there are, we need at
+  // least psig snapshots.  So does ESPRIT even for one tone, since
+  // a real tone spans a 2-D signal subspace.  The grid searches only
+  // follow one peak.
+  if ((ntones > 1) || (order != ORDER_FIXED) || (search == SEARCH_ESPRIT)) {
+    if (npts-m+1 < psig) {
+      printf("Need L <= npts-%d+1 for %d tones.\n", psig, ntones);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (ntones > 1) {
+    if (search == SEARCH_GRID) {
+      printf("More than one tone needs '-m fft', 'refine', 'root' or 'esprit'.\n");
+      exit(EXIT_FAILURE);
+    }
+  }
+  if (hop && zoom) {
+    printf("-H and -Z can't be used together.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (hop && (lambda != 0.0f)) {
+    printf("-H and -X can't be used together.\n");
+    exit(EXIT_FAILURE);
+  }
+  if ((every < 1) || ((every > 1) && !hop && (lambda == 0.0f))) {
+    printf("-D needs nframes >= 1 and one of -H or -X.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (tol <= 0.0f) {
+    printf("Need tol > 0.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (windowed && (search != SEARCH_GRID)) {
+    printf("-w only works with '-m grid'.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // The model order test needs the eigenvalues, which the tracker
+  // doesn't have.
+  if ((order != ORDER_FIXED) && ((decomp == DECOMP_TRACK) || (decomp == DECOMP_UNITARY))) {
+    printf("-O needs '-d svd' or '-d eig'.\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // The Toeplitz path works from each frame's lags alone and only
+  // ever finds Pisarenko's noise vector.  Its covariance is already
+  // persymmetric, so -F would change nothing.
+  if (decomp == DECOMP_TOEPLITZ) {
+    if (estimator == MUSIC_EST_MINNORM) {
+      printf("'-d toeplitz' only does '-E pisarenko'.\n");
+      exit(EXIT_FAILURE);
+    }
+    if (hop || (lambda != 0.0f) || (order != ORDER_FIXED)) {
+      printf("'-d toeplitz' can't be used with -H, -X or -O.\n");
+      exit(EXIT_FAILURE);
+    }
+    estimator = MUSIC_EST_PISARENKO;
+    fb = 0;
+  }
+
+  // Min-Norm and Pisarenko replace the MUSIC pseudospectrum, which
+  // ESPRIT doesn't use.  Pisarenko needs the smallest eigenvector,
+  // which the tracker, unitary MUSIC and the order test on the
+  // eigensolver path never compute, and it only means something if
+  // the covariance has full rank, i.e. averages at least L
+  // snapshots.
+  if ((estimator != MUSIC_EST_MUSIC) && (search == SEARCH_ESPRIT)) {
+    printf("-E needs a MUSIC search, not '-m esprit'.\n");
+    exit(EXIT_FAILURE);
+  }
+  if (estimator == MUSIC_EST_PISARENKO) {
+    if ((decomp == DECOMP_TRACK) || (decomp == DECOMP_UNITARY) ||
+        ((decomp == DECOMP_EIG) && (order != ORDER_FIXED))) {
+      printf("'-E pisarenko' needs '-d svd', or '-d eig' without -O.\n");
+      exit(EXIT_FAILURE);
+    }
+    if ((decomp != DECOMP_TOEPLITZ) && (lambda == 0.0f) &&
+        ((npts-m+1)*(fb ? 2 : 1) < m)) {
+      printf("'-E pisarenko' needs L <= %d for a full rank covariance.\n",
+             fb ? (2*npts+2)/3 : (npts+1)/2);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // The tracker and ESPRIT work with the signal subspace only.  So
+  // does the eigensolver when the model order changes per frame,
+  // since it only computes the largest eigenvectors, and so does
+  // unitary MUSIC.
+  if ((decomp == DECOMP_TRACK) || (search == SEARCH_ESPRIT) ||
+      (decomp == DECOMP_UNITARY) ||
+      ((decomp == DECOMP_EIG) && (order != ORDER_FIXED))) {
+    eval_mode = MUSIC_EVAL_SIGNAL;
+  }
+
+  // Min-Norm is built from the signal vectors and Pisarenko is a
+  // noise vector.  Either way the search sees one noise vector.
+  if (estimator == MUSIC_EST_MINNORM) {
+    eval_mode = MUSIC_EVAL_SIGNAL;
+  } else if (estimator == MUSIC_EST_PISARENKO) {
+    eval_mode = MUSIC_EVAL_NOISE;
+  }
+  smode = (estimator == MUSIC_EST_MUSIC) ? eval_mode : MUSIC_EVAL_NOISE;
+
+  // Unitary MUSIC gets forward-backward averaging for free from
+  // the way it splits Rxx, so hankel_cov needn't do it.
+  if (decomp == DECOMP_UNITARY) {
+    if (m % 2) {
+      printf("'-d unitary' needs L even.\n");
+      exit(EXIT_FAILURE);
+    }
+    fb = 0;
+  }
+
+  // The closed form decomposition only applies when Rxx is the
+  // single snapshot v*v', not a running average of them (-X).
+  if ((decomp == DECOMP_RANK1) && ((m != npts) || fb || (lambda != 0.0f))) {
+    decomp = DECOMP_SVD;
+  }
+
   printf("------------   Starting main.....   -------------\n");
 
   // Run until Ctrl+C pressed:
@@ -176,48 +643,302 @@ int main (void)
      exit(EXIT_FAILURE);
   }
 
-  // Initialize A/D converter
+  // Set up covariance workspace.
+  if (hankel_init(&hw, npts, m, fb) != 0) {
+    printf("Unable to set up covariance.  Exiting....\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // The rank 1 decomposition reads the window directly, so only
+  // keep the running covariance if something else looks at it.
+  if (hop && (hankel_slide_init(&hw, hop, (decomp != DECOMP_RANK1) || (every > 1)) != 0)) {
+    printf("Unable to set up sliding window.  Exiting....\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if ((lambda != 0.0f) && (hankel_exp_init(&hw, lambda) != 0)) {
+    printf("Unable to set up exponential covariance.  Exiting....\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if ((decomp == DECOMP_TRACK) && (opast_init(&ow, m, psig, TRACK_BETA) != 0)) {
+    printf("Unable to set up subspace tracker.  Exiting....\n");
+    exit(EXIT_FAILURE);
+  }
+
+  nraw = npts;
+  if (zoom) {
+    if (zoom_init(&zw, FSAMP, flo, fhi, npts, maxpts) != 0) {
+      printf("Unable to set up zoom.  Exiting....\n");
+      exit(EXIT_FAILURE);
+    }
+    nraw = zw.nin;
+    fs = (float) FSAMP/zw.D;
+    fshift = zw.fshift;
+    printf("Zoom:  mixing down by %f Hz, decimating by %d, %d samples per frame\n",
+           fshift, zw.D, nraw);
+  }
+
+  // Streaming, each half of the PRU's double buffer holds what one
+  // pass of the loop below reads.
+  nhalf = hop ? hop : nraw;
+  if ((acq == ACQ_STREAM) && ((nhalf > STREAM_MAXHALF) || (hop && (npts % hop != 0)))) {
+    printf("-S needs a frame (or hop) of at most %d samples, and hop to divide npts.\n",
+           STREAM_MAXHALF);
+    exit(EXIT_FAILURE);
+  }
+
+  if ((decomp == DECOMP_UNITARY) && (unitary_init(&uw, m, psig) != 0)) {
+    printf("Unable to set up unitary MUSIC.  Exiting....\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if ((decomp == DECOMP_TOEPLITZ) && (toep_init(&tz, npts, m) != 0)) {
+    printf("Unable to set up Toeplitz path.  Exiting....\n");
+    exit(EXIT_FAILURE);
+  }
+
+  // Set up steering vector workspace.  The first-level grid
+  // 0 .. FSAMP/2 is tabulated here, so the loop below does no
+  // allocation.
+  if (steer_init(&sw, m, NGRID, 0.0f/FSAMP, (FSAMP/2.0f)/FSAMP) != 0) {
+    printf("Unable to allocate steering vectors.  Exiting....\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (windowed) {
+    // The window moves every frame, so its table is never used
+    // directly.  Any band will do.
+    if (steer_init(&tw, m, FTRACK_NGRID, 0.0f/FSAMP, (FSAMP/2.0f)/FSAMP) != 0) {
+      printf("Unable to allocate steering vectors.  Exiting....\n");
+      exit(EXIT_FAILURE);
+    }
+    freqtrack_init(&ft, FTRACK_ALPHA, FTRACK_BETA);
+  }
+
+  if (fft_init(&fp, NFFT) != 0 || fft_init(&rp, ROOT_NFFT) != 0) {
+    printf("Unable to set up FFT.  Exiting....\n");
+    exit(EXIT_FAILURE);
+  }
+
+  if (logname != NULL) {
+    logfp = fopen(logname, "a");
+    if (logfp == NULL) {
+      printf("Unable to open %s.  Exiting....\n", logname);
+      exit(EXIT_FAILURE);
+    }
+  }
+
+  // Initialize A/D converter.  Configuration is done polling; the
+  // interrupt only matters for the reads in the loop.
   adc_config();
   adc_set_samplerate(SAMP_RATE_15625);
   adc_set_chan0();
+  if (irq) {
+    pru_set_completion(PRU_DONE_IRQ);
+  }
+  if (acq == ACQ_STREAM) {
+    adc_stream_start(nhalf);
+  } else if (acq == ACQ_RING) {
+    nring = adc_ring_start();
+    if (nring < nraw + RING_CHUNK) {
+      printf("DDR ring holds %u samples, too few for frames of %d.  Exiting....\n",
+             nring, nraw);
+      adc_quit();
+      exit(EXIT_FAILURE);
+    }
+  }
 
   // Now loop forever, read buffer, and compute frequency.
   // printf("--------------------------------------------------\n");
   while(1) {
 
-    // Do A/D read to fill buffer with NUMPTS measurements.
-    adc_read_multiple(NUMPTS, v);
+    // Do A/D read to fill buffer with npts measurements.  When
+    // zooming, read enough raw samples to make npts decimated ones.
+    // With a sliding window, only the first read is a full buffer;
+    // after that read hop samples and slide the window on.
+    if (hop) {
+      if (!filled) {
+        if (acq == ACQ_STREAM) {
+          for (i = 0; i < npts; i += hop) {
+            read_samples(acq, hop, &v[i]);
+          }
+        } else {
+          read_samples(acq, npts, v);
+        }
+        hankel_fill(&hw, v);
+        filled = 1;
+      } else {
+        read_samples(acq, hop, v);
+        hankel_push(&hw, v);
+      }
+      vw = hankel_window(&hw);
+    } else if (zoom) {
+      read_samples(acq, nraw, vraw);
+      zoom_run(&zw, vraw, v);
+      vw = v;
+    } else {
+      read_samples(acq, npts, v);
+      vw = v;
+    }
     //printf("Values read = \n");
-    //for (i=0; i<NUMPTS; i++) {
+    //for (i=0; i<npts; i++) {
     //  printf("i = %d, v = %e\n", i, v[i]);
     //}
  
-    // Zero out Rxx prior to filling it using sger
-    zeros(m, m, Rxx);  
-
-    // Create covariance matrix by doing outer product of v with
-    // itself.
-    cblas_sger(CblasRowMajor,    /* Row-major storage */
-               m,                /* Row count for Rxx  */
-               m,                /* Col count for Rxx  */
-               1.0f,             /* scale factor to apply to v*v' */
-               v,
-               1,                /* stride between elements of v. */
-               v,
-               1,                /* stride between elements of v. */
-               Rxx,
-               m);               /* leading dimension of matrix Rxx. */
-    //printf("\nMatrix Rxx (%d x %d) =\n", m, m);
-    //print_matrix(Rxx, m, m);
-
-    // Now compute SVD of Rxx.
-    info = LAPACKE_sgesvd(LAPACK_ROW_MAJOR, 'A', 'A', 
-                  m, m, Rxx, 
-                  m, S, U, m, 
-                  VT, m, superb);
-    if (info != 0)  {
-      fprintf(stderr, "Error: dgesvd returned with a non-zero status (info = %d)\n", info);
-      return(-1);
+    if (lambda != 0.0f) {
+      hankel_update(&hw, vw);
+    }
+
+    // If the covariance has barely moved since we last decomposed
+    // it, the subspaces and so the estimate are the same as last
+    // time, so skip all the work.
+    if ((every > 1) && (since > 0) && (since < every) &&
+        (hankel_drift(&hw) < COV_DRIFT)) {
+      since++;
+      print_record(ntones, fpk, have_signal);
+      if (timing) {
+        printf("Reused last decomposition\n");
+      }
+      continue;
+    }
+    if (every > 1) {
+      hankel_mark(&hw);
+      since = 1;
+    }
+
+    timer_start(&tstart);
+    psig = pmax;
+    if (decomp == DECOMP_RANK1) {
+      // Rxx = v*v' has rank 1, so skip building it and get the
+      // subspaces in closed form.
+      rank1_basis(vw, m, U, S);
+    } else if (decomp == DECOMP_EIG) {
+      // Only compute the eigenvectors we need.  They land directly
+      // in Es or Nu, so there is nothing to extract afterwards.
+      hankel_cov(&hw, vw, Rxx);
+      if (order != ORDER_FIXED) {
+        // The order test needs the trace and log determinant of
+        // Rxx, and the eigensolver is about to destroy it.
+        tr = 0.0f;
+        for (i = 0; i < m; i++) {
+          tr += Rxx[i*m+i];
+        }
+        eps = ORDER_EPS*tr/m;
+        logdet = logdet_loaded(Rxx, m, eps, VT);
+      }
+      // Pisarenko only wants the smallest one.
+      info = eig_subspace(Rxx, m, (estimator == MUSIC_EST_PISARENKO) ? m-1 : psig,
+                          eval_mode == MUSIC_EVAL_SIGNAL,
+                          (eval_mode == MUSIC_EVAL_SIGNAL) ? Es : Nu, S, isuppz);
+      if (info != 0)  {
+        fprintf(stderr, "Error: ssyevr returned with a non-zero status (info = %d)\n", info);
+        return(-1);
+      }
+      if (order != ORDER_FIXED) {
+        // Eigenvalues and the columns of Es come out ascending.
+        // Keep the last psig columns.
+        for (i = 0; i < pmax; i++) {
+          lam[i] = S[pmax-1-i];
+        }
+        d = model_order(order, lam, pmax, m, hw.K*(fb ? 2 : 1), tr, logdet, eps);
+        psig = MIN(pmax, 2*((d+1)/2));
+        for (i = 0; i < m; i++) {
+          for (j = 0; j < psig; j++) {
+            Es[i*psig+j] = Es[i*pmax+pmax-psig+j];
+          }
+        }
+      }
+    } else if (decomp == DECOMP_UNITARY) {
+      // Two half-size real eigenproblems.  The full length signal
+      // vectors land in Es for the estimators that want them.
+      hankel_cov(&hw, vw, Rxx);
+      info = unitary_subspace(&uw, Rxx, psig, Es);
+      if (info != 0)  {
+        fprintf(stderr, "Error: ssyevr returned with a non-zero status (info = %d)\n", info);
+        return(-1);
+      }
+    } else if (decomp == DECOMP_TOEPLITZ) {
+      // L lags straight from the samples, then Pisarenko's noise
+      // vector by Levinson recursions.  Rxx is never built.
+      toep_lags(&tz, vw, rlag);
+      toep_pisarenko(&tz, rlag, Nu);
+    } else if (decomp == DECOMP_TRACK) {
+      // Update the signal subspace from this frame's snapshots.  If
+      // it is time for a refresh, or the subspace has drifted, redo
+      // the full decomposition and restart the tracker from it.
+      if (!need_refresh) {
+        // With a sliding window only the last hop snapshots are new.
+        if (hop && (hop < npts-m+1)) {
+          resid = opast_frame(&ow, &vw[npts-(hop+m-1)], hop+m-1);
+        } else {
+          resid = opast_frame(&ow, vw, npts);
+        }
+        track_frames++;
+        if ((track_frames >= TRACK_REFRESH) || (resid > resid0 + TRACK_DRIFT)) {
+          need_refresh = 1;
+        }
+      }
+      if (need_refresh) {
+        hankel_cov(&hw, vw, Rxx);
+        info = eig_subspace(Rxx, m, psig, 1, Es, S, isuppz);
+        if (info != 0)  {
+          fprintf(stderr, "Error: ssyevr returned with a non-zero status (info = %d)\n", info);
+          return(-1);
+        }
+        opast_reset(&ow, Es, S);
+        resid0 = opast_residual(&ow, vw, npts);
+        need_refresh = 0;
+        track_frames = 0;
+      }
+      for (i = 0; i < m*psig; i++) {
+        Es[i] = ow.W[i];
+      }
+    } else {
+      // Create covariance matrix from the overlapping snapshots of
+      // v.  This fills only the upper triangle, so mirror it for
+      // the SVD.
+      hankel_cov(&hw, vw, Rxx);
+      symmetrize_upper(m, Rxx);
+      //printf("\nMatrix Rxx (%d x %d) =\n", m, m);
+      //print_matrix(Rxx, m, m);
+
+      // Now compute SVD of Rxx.
+      info = LAPACKE_sgesvd(LAPACK_ROW_MAJOR, 'A', 'A', 
+                    m, m, Rxx, 
+                    m, S, U, m, 
+                    VT, m, superb);
+      if (info != 0)  {
+        fprintf(stderr, "Error: dgesvd returned with a non-zero status (info = %d)\n", info);
+        return(-1);
+      }
+
+      if (order != ORDER_FIXED) {
+        // S holds all the eigenvalues, largest first.
+        tr = 0.0f;
+        for (i = 0; i < m; i++) {
+          tr += S[i];
+        }
+        eps = ORDER_EPS*tr/m;
+        logdet = 0.0;
+        for (i = 0; i < m; i++) {
+          logdet += log(S[i] + eps);
+        }
+        d = model_order(order, S, pmax, m, hw.K*(fb ? 2 : 1), tr, logdet, eps);
+        psig = MIN(pmax, 2*((d+1)/2));
+      }
+    }
+
+    // Nothing but noise in this frame, so there is nothing to
+    // search for.
+    if (psig == 0) {
+      tdecomp = timer_elapsed_us(&tstart);
+      have_signal = 0;
+      print_record(ntones, fpk, have_signal);
+      if (timing) {
+        printf("Decomposition took %f us\n", tdecomp);
+      }
+      continue;
     }
 
     //printf("\nMatrix U (%d x %d) is:\n", m, m);
@@ -229,38 +950,175 @@ int main (void)
     //printf("\nMatrix VT (%d x %d) is:\n", m, m);
     //print_matrix(VT, m, m);
 
-    // Extract noise vectors here.  The noise vectors are held in Nu
-    extract_noise_vectors(U, m, m, PSIG, Nu); 
-    //printf("\nMatrix Nu (%d x %d) is:\n", m, NUMPTS-PSIG);
-    //print_matrix(Nu, m, NUMPTS-PSIG);
+    // Extract noise vectors here.  The noise vectors are held in Nu.
+    // The signal evaluator only needs the first psig columns of U,
+    // held in Es.
+    if (estimator == MUSIC_EST_PISARENKO) {
+      // Just the last column of U, the smallest eigenvector.
+      if ((decomp != DECOMP_EIG) && (decomp != DECOMP_TOEPLITZ)) {
+        extract_noise_vectors(U, m, m, m-1, Nu);
+      }
+      Vs = Nu;
+      nvec = 1;
+    } else if (eval_mode == MUSIC_EVAL_NOISE) {
+      if (decomp != DECOMP_EIG) {
+        extract_noise_vectors(U, m, m, psig, Nu); 
+      }
+      Vs = Nu;
+      nvec = m-psig;
+    } else {
+      if ((decomp != DECOMP_EIG) && (decomp != DECOMP_TRACK) && (decomp != DECOMP_UNITARY)) {
+        extract_signal_vectors(U, m, m, psig, Es); 
+      }
+      Vs = Es;
+      nvec = psig;
+    }
+    if (estimator == MUSIC_EST_MINNORM) {
+      minnorm_vector(Es, m, psig, Nu);
+      Vs = Nu;
+      nvec = 1;
+    }
+    tdecomp = timer_elapsed_us(&tstart);
+    //printf("\nMatrix Nu (%d x %d) is:\n", m, m-psig);
+    //print_matrix(Nu, m, m-psig);
+
+    timer_start(&tstart);
+    if (search == SEARCH_ESPRIT) {
+      // Frequencies come straight from the signal subspace.
+      npk = esprit(Es, m, psig, fesp);
+      if (npk < 0) {
+        npk = 0;
+      }
+      for (i = 0; i < npk; i++) {
+        fpk[i] = fesp[i]*fs;
+      }
+    } else if (search == SEARCH_ROOT) {
+      // Seed Newton with the peaks of a coarse FFT spectrum, then
+      // polish the roots of the MUSIC polynomial one by one.
+      music_poly(smode, Vs, m, nvec, c);
+      music_spectrum_fft(&rp, c, m, Pfft);
+      npk = spectrum_peaks(Pfft, ROOT_NFFT/2+1, psig/2, (float) ROOT_NFFT/(2*m), ipk);
+      for (i = 0; i < npk; i++) {
+        fpk[i] = music_root(c, m, ipk[i]/ROOT_NFFT, &radius)*fs;
+      }
+    } else if (search == SEARCH_REFINE) {
+      // The coarse FFT finds the bins holding the peaks.  The bins
+      // on either side of each bracket it, and Newton does the
+      // rest.
+      music_poly(smode, Vs, m, nvec, c);
+      music_spectrum_fft(&rp, c, m, Pfft);
+      npk = spectrum_peaks(Pfft, ROOT_NFFT/2+1, psig/2, (float) ROOT_NFFT/(2*m), ipk);
+      nevals = 0;
+      for (i = 0; i < npk; i++) {
+        ipeak = (int) (ipk[i] + 0.5f);
+        fleft = (ipeak > 0) ? (float) (ipeak-1)/ROOT_NFFT : 0.0f;
+        fright = (ipeak < ROOT_NFFT/2) ? (float) (ipeak+1)/ROOT_NFFT : 0.5f;
+        fpk[i] = music_refine(c, m, (float) ipeak/ROOT_NFFT, fleft, fright,
+                              tol/fs, &nev)*fs;
+        nevals += nev;
+      }
+    } else if (search == SEARCH_FFT) {
+      // One pass:  get polynomial coefficients from the diagonal
+      // sums of the noise projector, then FFT them.
+      music_poly(smode, Vs, m, nvec, c);
+      music_spectrum_fft(&fp, c, m, Pfft);
+      npk = spectrum_peaks(Pfft, NFFT/2+1, psig/2, (float) NFFT/(2*m), ipk);
+      for (i = 0; i < npk; i++) {
+        fpk[i] = ipk[i]*fs/NFFT;
+      }
+
+      if (logfp != NULL) {
+        for (i = 0; i <= NFFT/2; i++) {
+          fprintf(logfp, "%e ", Pfft[i]);
+        }
+        fprintf(logfp, "\n");
+      }
+    } else {
+      // If we are tracking a tone, first try one small grid around
+      // the predicted frequency.  Accept the peak if it is inside
+      // the window and about as high as when we acquired it.
+      found = 0;
+      nevals = 0;
+      if (windowed && ft.locked) {
+        freqtrack_window(&ft, fs/2.0f, &fleft, &fright);
+        if ((decomp == DECOMP_UNITARY) && (estimator == MUSIC_EST_MUSIC)) {
+          unitary_grid(&uw, fleft/fs, fright/fs, FTRACK_NGRID, Pmu);
+        } else if (batched) {
+          music_grid_batched(&tw, smode, fleft/fs, fright/fs, Vs, nvec, Pmu);
+        } else {
+          music_grid(&tw, smode, fleft/fs, fright/fs, Vs, nvec, Pmu);
+        }
+        nevals = FTRACK_NGRID;
+        ipeak = maxeltf(FTRACK_NGRID, Pmu);
+        if ((ipeak > 0) && (ipeak < FTRACK_NGRID-1)) {
+          fpeak = fleft + spectrum_peak(Pmu, FTRACK_NGRID)*(fright-fleft)/(FTRACK_NGRID-1);
+          found = (freqtrack_update(&ft, fpeak, Pmu[ipeak]) == 0);
+        }
+      }
+
+      if (!found) {
+        // Now find max freq.  Set up initial grid endpoints.  Freqs are
+        // in units of Hz.
+        fleft = 0.0f;
+        fright = fs/2.0f;
 
-    // Now find max freq.  Set up initial grid endpoints.  Freqs are
-    // in units of Hz.
-    fleft = 0.0f;
-    fright = FSAMP/2.0f;
+        for (j=0; j<MAXRECURSIONS; j++) {
+          // printf("fleft = %f, fright = %f\n", fleft, fright);
 
-    for (j=0; j<MAXRECURSIONS; j++) {
-      // printf("fleft = %f, fright = %f\n", fleft, fright);
+          // Set up search grid
+          linspace(fleft, fright, NGRID, f);
+          //printf("\nVector f =\n");
+          //print_matrix(f, NGRID, 1);
 
-      // Set up search grid
-      linspace(fleft, fright, NGRID, f);
-      //printf("\nVector f =\n");
-      //print_matrix(f, NGRID, 1);
+          // Compute vector of amplitudes Pmu on grid.  music_grid wants normalized
+          // frequencies 
+          if ((decomp == DECOMP_UNITARY) && (estimator == MUSIC_EST_MUSIC)) {
+            unitary_grid(&uw, fleft/fs, fright/fs, NGRID, Pmu);
+          } else if (batched) {
+            music_grid_batched(&sw, smode, fleft/fs, fright/fs, Vs, nvec, Pmu);
+          } else {
+            music_grid(&sw, smode, fleft/fs, fright/fs, Vs, nvec, Pmu);
+          }
+          //printf("\nVector Pmu =\n");
+          //print_matrix(Pmu, NGRID, 1);
 
-      // Compute vector of amplitudes Pmu on grid.  music_sum wants normalized
-      // frequencies 
-      for (i = 0; i < NGRID; i++) {
-        Pmu[i] = music_sum(f[i]/FSAMP, Nu, NUMPTS, NUMPTS-PSIG);
+          find_bracket(NGRID, Pmu, &ileft, &iright); 
+          fleft = f[ileft];
+          fright = f[iright];
+        }
+        fpeak = (fleft+fright)/2.0f;   // Assume peak is average of fleft and fright
+        nevals += MAXRECURSIONS*NGRID;
+        if (windowed) {
+          freqtrack_reset(&ft, fpeak, Pmu[maxeltf(NGRID, Pmu)]);
+        }
       }
-      //printf("\nVector Pmu =\n");
-      //print_matrix(Pmu, NGRID, 1);
+      fpk[0] = fpeak;
+      npk = 1;
+    }
+    tsearch = timer_elapsed_us(&tstart);
 
-      find_bracket(NGRID, Pmu, &ileft, &iright); 
-      fleft = f[ileft];
-      fright = f[iright];
+    // Report the tones in ascending order, padding with 0 for any
+    // we didn't find.  Undo the zoom mix first.
+    for (i = 0; i < npk; i++) {
+      fpk[i] += fshift;
+    }
+    sortf(npk, fpk);
+    for (i = npk; i < ntones; i++) {
+      fpk[i] = 0.0f;
+    }
+    // ESPRIT finds nothing when the rotation matrix is singular,
+    // has only real eigenvalues or LAPACK fails, which is no
+    // signal rather than a tone at 0 Hz.
+    have_signal = (search != SEARCH_ESPRIT) || (npk > 0);
+    print_record(ntones, fpk, have_signal);
+    if (timing) {
+      printf("Decomposition took %f us, peak search took %f us\n", tdecomp, tsearch);
+      if (search == SEARCH_REFINE) {
+        printf("Newton refinement used %d evaluations\n", nevals);
+      } else if (search == SEARCH_GRID) {
+        printf("Grid search used %d evaluations\n", nevals);
+      }
     }
-    fpeak = (fleft+fright)/2.0f;   // Assume peak is average of fleft and fright
-    printf("Peak frequency found at f = %f Hz\n", fpeak);
 
     // usleep(500000);   // delay 1/2 sec.
   }
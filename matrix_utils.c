@@ -57,6 +57,19 @@ void zeros(int m, int n, float *A) {
 }
 
 
+//-----------------------------------------------------
+void symmetrize_upper(int n, float *A) {
+  // A is an nxn symmetric matrix with only the upper triangle
+  // filled in.  Copy the upper triangle into the lower one.
+  int i, j;
+  for (i = 0; i < n; i++) {
+    for (j = 0; j < i; j++) {
+      MATRIX_ELEMENT(A, n, n, i, j) = MATRIX_ELEMENT(A, n, n, j, i);
+    }
+  }
+}
+
+
 //-----------------------------------------------------
 void linspace(float x0, float x1, int N, float *v) {
   // Returns vector v with N values from x0 to x1
@@ -92,4 +105,19 @@ int maxeltf(int N, float *u) {
 }
 
 
+//-----------------------------------------------------
+void sortf(int N, float *u) {
+  // Sort float vector u with N elements into ascending order.
+  // Insertion sort, fine for the handful of elements we use it
+  // on.
+  int i, j;
+  float t;
 
+  for (i = 1; i < N; i++) {
+    t = u[i];
+    for (j = i; (j > 0) && (u[j-1] > t); j--) {
+      u[j] = u[j-1];
+    }
+    u[j] = t;
+  }
+}
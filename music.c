@@ -0,0 +1,633 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+#include "cblas.h"
+
+#include "matrix_utils.h"
+#include "fft.h"
+#include "music.h"
+
+//===========================================================
+// This file holds the fcns which implement the MUSIC algorithm
+// proper:  splitting the SVD output into signal and noise spaces,
+// evaluating the pseudospectrum at a given frequency, and
+// helpers used in the peak search.  main.c just strings these
+// together.
+
+
+//-----------------------------------------------------
+void find_bracket(int N, float *u, int *ileft, int *iright) {
+  // Given input vector y, this finds the max element,
+  // then returns the indices of the vectors to its
+  // left and right.
+
+  int i;
+
+  i = maxeltf(N, u);
+  if (i == 0) {
+    *ileft = 0;
+    *iright = 1;
+  } else if (i == (N-1)) {
+    *ileft = N-2;
+    *iright = N-1;
+  } else {
+    *ileft = i-1;
+    *iright = i+1;
+  }
+  return;
+}
+
+
+//-----------------------------------------------------
+void extract_noise_vectors(float *A, int m, int n, int c, float *E) {
+  // This fcn takes input matrix A of size mxn.  It extracts the vectors
+  // of A to the right, starting at col c, and puts the extracted
+  // vectors into E.  E has size [m, n-c]
+
+  //printf("Entered extract_noise_vectors, m = %d, n = %d, c = %d\n", m, n, c);
+  int i, j, l;
+  for (i = 0; i < m; i++) {
+    for (j = c; j < n; j++) {
+      // printf("i = %d, j = %d, A[i,j] = %f\n", i, j, MATRIX_ELEMENT(A, m, n, i, j));
+      l = lindex(m, n-c, i, j-c);
+      // printf("lindex(m, n-c, i,j-c) = %d\n", l);
+      E[l] = MATRIX_ELEMENT(A, m, n, i, j);
+    }
+  }
+}
+
+
+//-----------------------------------------------------
+void extract_signal_vectors(float *A, int m, int n, int c, float *E) {
+  // Companion to extract_noise_vectors.  This takes input matrix
+  // A of size mxn and extracts the c leftmost columns (the signal
+  // vectors when A = U from the SVD).  E has size [m, c]
+  int i, j;
+  for (i = 0; i < m; i++) {
+    for (j = 0; j < c; j++) {
+      E[lindex(m, c, i, j)] = MATRIX_ELEMENT(A, m, n, i, j);
+    }
+  }
+}
+
+
+//-----------------------------------------------------
+void minnorm_vector(const float *Es, int m, int c, float *d) {
+  // Min-Norm replaces the sum over all noise vectors with the one
+  // vector d of the noise subspace having d(0) = 1 and least norm,
+  //   d = Pn*u1/(u1'*Pn*u1),  u1 = [1 0 ... 0]'
+  // With Pn = I - Es*Es' only the first row of the [m, c] signal
+  // vectors Es is needed:
+  //   Pn*u1 = u1 - Es*Es(0,:)'
+  // The scale of d doesn't move the peaks, so I normalize it to
+  // unit length, which keeps the pseudospectrum on the same footing
+  // as the noise sum.  d has size [m, 1].
+  float nrm;
+
+  cblas_sgemv(CblasRowMajor, CblasNoTrans, m, c,
+              -1.0f, Es, c,
+              Es, 1,           /* First row of Es */
+              0.0f, d, 1);
+  d[0] = d[0] + 1.0f;
+
+  // If u1 lies in the signal subspace there is no such vector.
+  // Leave d tiny and let the pseudospectrum guard deal with it.
+  nrm = cblas_snrm2(m, d, 1);
+  if (nrm > FLT_EPSILON) {
+    cblas_sscal(m, 1.0f/nrm, d, 1);
+  }
+}
+
+
+//-----------------------------------------------------
+int steer_init(steer_ws *ws, int M, int N, float f0, float f1) {
+  // Allocate the steering vector workspace and fill in the table
+  // for the first-level grid.  f0 and f1 are normalized
+  // frequencies (f/FSAMP).  The first-level grid is the same
+  // every frame, so the cos and sin calls happen once, here.
+  // Returns 0 on success, -1 if malloc fails.
+  int i, k;
+  float df;
+
+  ws->M = M;
+  ws->N = N;
+  ws->f0 = f0;
+  ws->f1 = f1;
+  ws->tab = (float*) malloc(2*N*M*sizeof(float));
+  ws->grid = (float*) malloc(2*N*M*sizeof(float));
+  ws->proj = (float*) malloc(2*N*M*sizeof(float));
+  if (!ws->tab || !ws->grid || !ws->proj) {
+    steer_free(ws);
+    return -1;
+  }
+
+  df = (f1-f0)/(N-1);
+  for (k = 0; k < N; k++) {
+    for (i = 0; i < M; i++) {
+      ws->tab[lindex(2*N, M, k, i)] = cos(2*PI*i*(f0 + k*df));
+      ws->tab[lindex(2*N, M, N+k, i)] = sin(2*PI*i*(f0 + k*df));
+    }
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------
+void steer_free(steer_ws *ws) {
+  free(ws->tab);
+  free(ws->grid);
+  free(ws->proj);
+  ws->tab = ws->grid = ws->proj = NULL;
+}
+
+
+//-----------------------------------------------------
+float *steer_grid(steer_ws *ws, float f0, float f1) {
+  // Return a pointer to the [2N, M] matrix of steering vectors for
+  // the N equally spaced normalized frequencies f0 .. f1.  Row k
+  // holds the real part for point k, row N+k the imag part.  If
+  // [f0, f1] is the first-level grid this is just the table,
+  // otherwise we generate them into ws->grid with steer_rotate.
+  // The rotor itself is stepped across the grid by recurrence, so
+  // only one cos/sin pair per level is needed.
+  int k;
+  int M = ws->M;
+  int N = ws->N;
+  double rc, rs, dc, ds, t;
+
+  if (f0 == ws->f0 && f1 == ws->f1) {
+    return ws->tab;
+  }
+
+  rc = cos(2*PI*f0);
+  rs = sin(2*PI*f0);
+  dc = cos(2*PI*(f1-f0)/(N-1));
+  ds = sin(2*PI*(f1-f0)/(N-1));
+  for (k = 0; k < N; k++) {
+    steer_rotate(rc, rs, &ws->grid[k*M], &ws->grid[(N+k)*M], M);
+    t = rc*dc - rs*ds;
+    rs = rc*ds + rs*dc;
+    rc = t;
+  }
+  return ws->grid;
+}
+
+
+//-----------------------------------------------------
+void steer_rotate(double c, double s, float *er, float *ei, int M) {
+  // Fill er + j*ei with the steering vector exp(j*w*i), i = 0..M-1,
+  // given only the rotor c + j*s = exp(j*w).  Each element is the
+  // previous one times the rotor, so there are no cos or sin calls.
+  // Roundoff makes the magnitude drift away from 1, so every
+  // STEER_RENORM steps we pull it back with one Newton step for
+  // 1/sqrt(|z|^2), which is accurate since |z| stays close to 1.
+  int i;
+  float zr, zi, t, g;
+  float fc = (float) c;
+  float fs = (float) s;
+
+  zr = 1.0f;
+  zi = 0.0f;
+  for (i = 0; i < M; i++) {
+    er[i] = zr;
+    ei[i] = zi;
+    t = zr*fc - zi*fs;
+    zi = zr*fs + zi*fc;
+    zr = t;
+    if ((i % STEER_RENORM) == (STEER_RENORM-1)) {
+      g = 0.5f*(3.0f - (zr*zr + zi*zi));
+      zr = g*zr;
+      zi = g*zi;
+    }
+  }
+}
+
+
+//-----------------------------------------------------
+static float pmu_from_denom(float s, int Mr) {
+  // Turn the denominator e'*Pn*e into the pseudospectrum value.
+  // Must guard against returning inf or nan.  In signal mode the
+  // subtraction cancels almost completely near the peak and
+  // roundoff can drive s to zero or below.
+  if (s < Mr*FLT_EPSILON) {
+    s = Mr*FLT_EPSILON;
+  }
+  return (1.0f/s);
+}
+
+
+//-----------------------------------------------------
+float music_pmu(int mode, const float *er, const float *ei, float *v, int Mr, int Mc) {
+  // Evaluate the pseudospectrum 1/(e'*Pn*e) for steering vector
+  // e = er + j*ei.  Since complex numbers are not supported, I split
+  // the computation into two parts, real and imag.
+  //
+  // mode = MUSIC_EVAL_NOISE:  v is the [Mr, Mc] matrix of noise
+  //   vectors and we sum |v_k'*e|^2 over its columns.
+  // mode = MUSIC_EVAL_SIGNAL:  v is the [Mr, Mc] matrix of signal
+  //   vectors.  Since the columns of U form an orthonormal basis,
+  //     e'*Pn*e = ||e||^2 - ||Es'*e||^2
+  //   so we only need to touch the Mc = PSIG signal columns.  For
+  //   the usual PSIG = 2 this is ~60x fewer MACs than the noise sum.
+  //
+  // Columns of v are read in place using stride Mc, so no
+  // copying or allocation happens here.
+  int i;
+  float s, tr, ti;
+
+  s = 0;
+  for(i=0; i<Mc; i++) {     // iterate over columns.
+    tr = cblas_sdot(Mr, er, 1, &v[i], Mc);
+    ti = cblas_sdot(Mr, ei, 1, &v[i], Mc);
+    s = s + tr*tr + ti*ti;
+  }
+
+  // Each element of e has unit magnitude, so ||e||^2 = Mr.
+  if (mode == MUSIC_EVAL_SIGNAL) {
+    s = Mr - s;
+  }
+
+  return pmu_from_denom(s, Mr);
+}
+
+
+//-----------------------------------------------------
+void music_grid(steer_ws *ws, int mode, float f0, float f1, float *v, int Mc, float *Pmu) {
+  // Evaluate the pseudospectrum on ws->N equally spaced normalized
+  // frequencies from f0 to f1 and put the result into Pmu.  This
+  // is the hot loop of the peak search, so it does no allocation
+  // and no transcendental calls per point.
+  int k;
+  int M = ws->M;
+  int N = ws->N;
+  float *E;
+
+  E = steer_grid(ws, f0, f1);
+  for (k = 0; k < N; k++) {
+    Pmu[k] = music_pmu(mode, &E[k*M], &E[(N+k)*M], v, M, Mc);
+  }
+}
+
+
+//-----------------------------------------------------
+void music_grid_batched(steer_ws *ws, int mode, float f0, float f1, float *v, int Mc, float *Pmu) {
+  // Same result as music_grid, but instead of 2*N*Mc separate dot
+  // products we project the whole [2N, M] steering matrix onto
+  // the [M, Mc] subspace matrix v with one SGEMM, then reduce the
+  // squared magnitudes in one pass:
+  //   proj = [cos; sin] * v          [2N, Mc]
+  //   s_k  = sum_j proj(k,j)^2 + proj(N+k,j)^2
+  // Level-3 BLAS makes much better use of cache and SIMD, which is
+  // what makes denser grids affordable.
+  int j, k;
+  int M = ws->M;
+  int N = ws->N;
+  float *E;
+  float *P = ws->proj;
+  float s;
+
+  E = steer_grid(ws, f0, f1);
+  cblas_sgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+              2*N,             /* Rows of steering matrix */
+              Mc,              /* Cols of subspace matrix */
+              M,               /* Inner dimension */
+              1.0f, E, M,
+              v, Mc,
+              0.0f, P, Mc);
+
+  for (k = 0; k < N; k++) {
+    s = 0.0f;
+    for (j = 0; j < Mc; j++) {
+      s = s + P[k*Mc+j]*P[k*Mc+j] + P[(N+k)*Mc+j]*P[(N+k)*Mc+j];
+    }
+    if (mode == MUSIC_EVAL_SIGNAL) {
+      s = M - s;
+    }
+    Pmu[k] = pmu_from_denom(s, M);
+  }
+}
+
+
+//-----------------------------------------------------
+void music_poly(int mode, float *v, int Mr, int Mc, float *c) {
+  // The MUSIC denominator is a trigonometric polynomial in w:
+  //   e'*Pn*e = sum_{k=-(Mr-1)}^{Mr-1} c_k exp(j*w*k)
+  // where c_k is the sum along the kth diagonal of the noise
+  // projector Pn = Nu*Nu'.  Pn is symmetric, so c_-k = c_k and
+  // we only return c[0 .. Mr-1].
+  //
+  // With v row-major, rows i and i+k of v are contiguous, so
+  //   c_k = sum_i v(i,:) . v(i+k,:)
+  // collapses to a single dot product of length (Mr-k)*Mc.
+  //
+  // mode = MUSIC_EVAL_NOISE:  v is [Mr, Mc] noise vectors, Pn = v*v'.
+  // mode = MUSIC_EVAL_SIGNAL: v is [Mr, Mc] signal vectors and
+  //   Pn = I - v*v', which needs O(Mr^2*PSIG) work instead of
+  //   O(Mr^2*(Mr-PSIG)).
+  int k;
+
+  for (k = 0; k < Mr; k++) {
+    c[k] = cblas_sdot((Mr-k)*Mc, v, 1, &v[k*Mc], 1);
+    if (mode == MUSIC_EVAL_SIGNAL) {
+      c[k] = -c[k];
+    }
+  }
+  if (mode == MUSIC_EVAL_SIGNAL) {
+    c[0] = c[0] + Mr;
+  }
+}
+
+
+//-----------------------------------------------------
+void music_spectrum_fft(fft_plan *p, const float *c, int Mr, float *Pmu) {
+  // Evaluate the pseudospectrum at the p->n/2+1 normalized
+  // frequencies k/p->n, k = 0 .. p->n/2, from the polynomial
+  // coefficients c computed by music_poly.  Since c is symmetric
+  // the denominator at w = 2*pi*k/n is
+  //   c_0 + 2*sum_l c_l cos(w*l)
+  // which is exactly the real FFT of the even sequence
+  //   x = [c_0, c_1, .. c_{Mr-1}, 0, .., 0, c_{Mr-1}, .. c_1]
+  // So one zero-padded FFT gives the whole dense spectrum in
+  // O(n log n).  p->n must be at least 2*Mr.  x is built in the
+  // plan's scratch, so nothing is allocated per call.
+  int n = p->n;
+  int k;
+  float *x = p->x;
+
+  for (k = 0; k < n; k++) {
+    x[k] = 0.0f;
+  }
+  x[0] = c[0];
+  for (k = 1; k < Mr; k++) {
+    x[k] = c[k];
+    x[n-k] = c[k];
+  }
+
+  // Real part of the transform goes straight into Pmu, then
+  // gets inverted in place.  The imag part is zero since x is
+  // even.
+  fft_real(p, x, Pmu, p->Xi);
+  for (k = 0; k <= n/2; k++) {
+    Pmu[k] = pmu_from_denom(Pmu[k], Mr);
+  }
+}
+
+
+//-----------------------------------------------------
+static float peak_vertex(const float *Pmu, int N, int i) {
+  // Pmu has a local max at i.  The denominator 1/Pmu is smooth
+  // near its minimum, so fit a parabola through the three points
+  // around the max and return its vertex as a fractional index.
+  float dl, d0, dr, den;
+
+  if ((i == 0) || (i == N-1)) {
+    return (float) i;
+  }
+  dl = 1.0f/Pmu[i-1];
+  d0 = 1.0f/Pmu[i];
+  dr = 1.0f/Pmu[i+1];
+  den = dl - 2.0f*d0 + dr;
+  if (den <= 0.0f) {
+    return (float) i;
+  }
+  return i + 0.5f*(dl - dr)/den;
+}
+
+
+//-----------------------------------------------------
+float spectrum_peak(const float *Pmu, int N) {
+  // Given the pseudospectrum Pmu on N equally spaced points, find
+  // its max and return the fractional index of the peak.
+  return peak_vertex(Pmu, N, maxeltf(N, (float *) Pmu));
+}
+
+
+//-----------------------------------------------------
+int spectrum_peaks(const float *Pmu, int N, int K, float sep, float *idx) {
+  // Find up to K peaks of the pseudospectrum Pmu on N equally
+  // spaced points, highest first, and put their fractional
+  // indices into idx.  Returns the number found.
+  //
+  // Only local maxima count, and each peak we accept suppresses
+  // everything within sep points of it, so the skirts and ripple
+  // around a strong peak don't get reported as extra tones.  This
+  // is a greedy non-maximum suppression, O(K*N), and works on one
+  // spectrum for all the peaks.
+  int i, j, k, ibest;
+  float pbest;
+
+  if (sep < 1.0f) {
+    sep = 1.0f;
+  }
+  for (k = 0; k < K; k++) {
+    ibest = -1;
+    pbest = 0.0f;
+    for (i = 0; i < N; i++) {
+      if ((Pmu[i] <= pbest) ||
+          ((i > 0) && (Pmu[i-1] > Pmu[i])) ||
+          ((i < N-1) && (Pmu[i+1] > Pmu[i]))) {
+        continue;
+      }
+      for (j = 0; j < k; j++) {
+        if (fabsf(i - idx[j]) <= sep) {
+          break;
+        }
+      }
+      if (j == k) {
+        ibest = i;
+        pbest = Pmu[i];
+      }
+    }
+    if (ibest < 0) {
+      break;
+    }
+    idx[k] = peak_vertex(Pmu, N, ibest);
+  }
+  return k;
+}
+
+
+//-----------------------------------------------------
+float music_root(const float *c, int Mr, float f0, float *radius) {
+  // Root-MUSIC.  Multiplying the MUSIC denominator by z^(Mr-1)
+  // gives the degree 2(Mr-1) polynomial
+  //   p(z) = sum_{j=0}^{2Mr-2} c_{|j-(Mr-1)|} z^j
+  // whose roots come in pairs z, 1/conj(z).  The signal roots are
+  // the ones closest to the unit circle and their angles give the
+  // frequencies directly, without the resolution limit of a grid.
+  //
+  // Rather than computing all 2(Mr-1) roots with a companion matrix
+  // eigen solve, which costs far more than the SVD, we start from
+  // z = exp(j*2*pi*f0) at the pseudospectrum peak f0 (normalized)
+  // and polish the nearest root with Newton's method.  p and p' are
+  // evaluated together by Horner's rule, O(Mr) per iteration.
+  // Returns the normalized frequency of the root, folded into
+  // [0, 0.5], and puts |z| into radius.  If Newton wanders off we
+  // fall back to f0.
+  int i, j, deg;
+  double zr, zi, vr, vi, dr, di, t, den, sr, si, a;
+
+  deg = 2*(Mr-1);
+  zr = cos(2*PI*f0);
+  zi = sin(2*PI*f0);
+
+  for (i = 0; i < ROOT_MAXITER; i++) {
+    // Horner:  dp = dp*z + p;  p = p*z + a_j.  p = vr + j*vi,
+    // dp = dr + j*di.
+    vr = c[Mr-1];          // a_deg = c_{Mr-1}
+    vi = 0.0;
+    dr = 0.0;
+    di = 0.0;
+    for (j = deg-1; j >= 0; j--) {
+      t = dr*zr - di*zi + vr;
+      di = dr*zi + di*zr + vi;
+      dr = t;
+      a = c[abs(j-(Mr-1))];
+      t = vr*zr - vi*zi + a;
+      vi = vr*zi + vi*zr;
+      vr = t;
+    }
+
+    // Newton step s = p/p'
+    den = dr*dr + di*di;
+    if (den == 0.0) {
+      break;
+    }
+    sr = (vr*dr + vi*di)/den;
+    si = (vi*dr - vr*di)/den;
+    zr = zr - sr;
+    zi = zi - si;
+    if (sr*sr + si*si < ROOT_TOL*ROOT_TOL) {
+      break;
+    }
+  }
+
+  *radius = (float) sqrt(zr*zr + zi*zi);
+  if (!isfinite(*radius) || (fabs(*radius - 1.0) > ROOT_MAXDIST)) {
+    return f0;
+  }
+
+  // atan2 gives [-pi, pi].  A real tone has roots at +/- w, so
+  // fold onto [0, 0.5].
+  return (float) fabs(atan2(zi, zr)/(2*PI));
+}
+
+
+//-----------------------------------------------------
+static void refine_eval(const float *c, int Mr, double w, double *d1, double *d2) {
+  // Evaluate the first and second derivatives with respect to w
+  // of the MUSIC denominator
+  //   D(w) = c_0 + 2*sum_k c_k cos(k*w)
+  //   D'(w) = -2*sum_k k*c_k sin(k*w)
+  //   D''(w) = -2*sum_k k^2*c_k cos(k*w)
+  // cos(k*w) and sin(k*w) come from a rotor recurrence, so this is
+  // O(Mr) with one cos/sin pair.
+  int k;
+  double rc, rs, ck, sk, t, s1, s2;
+
+  rc = cos(w);
+  rs = sin(w);
+  ck = 1.0;
+  sk = 0.0;
+  s1 = 0.0;
+  s2 = 0.0;
+  for (k = 1; k < Mr; k++) {
+    t = ck*rc - sk*rs;
+    sk = ck*rs + sk*rc;
+    ck = t;
+    s1 = s1 - 2.0*k*c[k]*sk;
+    s2 = s2 - 2.0*k*k*c[k]*ck;
+  }
+  *d1 = s1;
+  *d2 = s2;
+}
+
+
+//-----------------------------------------------------
+float music_refine(const float *c, int Mr, float f0, float fl, float fr, float tol, int *nevals) {
+  // Refine a coarse peak of the pseudospectrum.  The peak of Pmu
+  // is the minimum of the MUSIC denominator D(w), so we look for a
+  // zero of D'(w) using the analytic derivatives from the
+  // polynomial coefficients c (see music_poly).  f0 is the coarse
+  // peak and [fl, fr] a bracket around it, all normalized.
+  //
+  // This is a safeguarded Newton iteration:  each evaluation of D'
+  // tells us which side of the current point the minimum lies on,
+  // so the bracket shrinks every step.  If the Newton step leaves
+  // the bracket, or D'' <= 0 so the step is uphill, we bisect
+  // instead.  Stop when the step is below tol (normalized).
+  // Near a well-defined peak this converges in a handful of
+  // evaluations.  *nevals gets the number of evaluations done.
+  double a, b, x, xn, d1, d2;
+
+  *nevals = 0;
+  a = 2*PI*fl;
+  b = 2*PI*fr;
+  x = 2*PI*f0;
+
+  while (*nevals < REFINE_MAXEVAL) {
+    refine_eval(c, Mr, x, &d1, &d2);
+    (*nevals)++;
+
+    // D' < 0 means D is still decreasing, so the minimum is to the
+    // right of x.
+    if (d1 < 0.0) {
+      a = x;
+    } else {
+      b = x;
+    }
+
+    if (d2 > 0.0) {
+      xn = x - d1/d2;
+    } else {
+      xn = 0.5*(a+b);
+    }
+    if ((xn <= a) || (xn >= b)) {
+      xn = 0.5*(a+b);
+    }
+
+    if (fabs(xn - x) < 2*PI*tol) {
+      x = xn;
+      break;
+    }
+    x = xn;
+  }
+  return (float) (x/(2*PI));
+}
+
+
+//-----------------------------------------------------
+float music_sum(steer_ws *ws, float f, float *v, int Mr, int Mc) {
+  // This performs the sum over noise space vectors at a single
+  // normalized frequency f.  This is the reference implementation
+  // -- keep it around to check the faster evaluators against.
+  // The peak search uses music_grid instead.  e is built in the
+  // first two rows of ws->grid, so Mr must be at most ws->M.
+  int i;
+  float *er = ws->grid;
+  float *ei = &ws->grid[ws->M];
+
+  // Create e vector
+  for(i=0; i<Mr; i++) {
+    er[i] = cos(2*PI*i*f);
+    ei[i] = sin(2*PI*i*f);
+  }
+  return music_pmu(MUSIC_EVAL_NOISE, er, ei, v, Mr, Mc);
+}
+
+
+//-----------------------------------------------------
+float music_sum_signal(steer_ws *ws, float f, float *v, int Mr, int Mc) {
+  // Same as music_sum, but computed from the [Mr, Mc] matrix
+  // of signal vectors.  See music_pmu.
+  int i;
+  float *er = ws->grid;
+  float *ei = &ws->grid[ws->M];
+
+  for(i=0; i<Mr; i++) {
+    er[i] = cos(2*PI*i*f);
+    ei[i] = sin(2*PI*i*f);
+  }
+  return music_pmu(MUSIC_EVAL_SIGNAL, er, ei, v, Mr, Mc);
+}
@@ -30,7 +30,9 @@ uint32_t data_bytes[4]
 */
 
 
-/* PRU-to-ARM interrupt */
+/* PRU-to-ARM interrupt.  Writing this to R31 raises system event
+   19, which the INTC routes to host interrupt PRU_EVTOUT0 (bit 5
+   strobes, the low bits are the event number - 16). */
 #define PRU0_ARM_INTERRUPT (19+16)
 
 #define CS 3     /* pr1_pru0_pru_r30_3 P9_28 */
@@ -40,6 +42,9 @@ uint32_t data_bytes[4]
 
 #define DELAY_CNT 30
 
+// Cycles in a microsecond at 200 MHz, for LIST_DELAY.
+#define CYCLES_PER_US 200
+
     
 //------------------------------------------------------------------------
 int main(void) {
@@ -64,6 +69,10 @@ int main(void) {
   uint32_t rx_word_cnt;
   uint32_t rx_words[4];
   uint32_t ncnv;
+  uint32_t half;
+  uint32_t head, mask;
+  uint32_t ncmd, c;
+  volatile uint32_t *pRing;
   uint32_t i;
   uint32_t memptr, rxmemptr;
 
@@ -73,6 +82,9 @@ int main(void) {
   volatile uint32_t *pMEM;
   pMEM = (&MEM_BASE)+RAMOFFSET;
 
+  // Enable the OCP master port, so we can write to the DDR ring.
+  CT_CFG.SYSCFG_bit.STANDBY_INIT = 0;
+
   // Always start with CS, CLK in 1 state
   __R30 = __R30 | (1 << CS);
   __R30 = __R30 | (1 << CLK);
@@ -102,6 +114,7 @@ int main(void) {
       // If printf is turned on in spidriver, then use 200000, else use 200
       __delay_cycles(200000);      
       pMEM[0] = 0x00;
+      __R31 = PRU0_ARM_INTERRUPT;
       break;
 
     //--------------------------------------------------
@@ -118,8 +131,10 @@ int main(void) {
       // Call fcn which does the bitbanging
       pru_spi_write(tx_words, tx_word_cnt);
 
-      // Tell ARM caller I am done.
+      // Tell ARM caller I am done, and wake it if it is sleeping
+      // on the interrupt.
       pMEM[0] = 0x00;
+      __R31 = PRU0_ARM_INTERRUPT;
 
       __delay_cycles(DELAY_CNT);
       break;
@@ -149,8 +164,10 @@ int main(void) {
       // Copy reply back into pMEM
       pMEM[rxmemptr] = rx_words[0];
 
-      // Tell ARM caller I am done.
+      // Tell ARM caller I am done, and wake it if it is sleeping
+      // on the interrupt.
       pMEM[0] = (uint32_t) 0x00;
+      __R31 = PRU0_ARM_INTERRUPT;
 
       __delay_cycles(DELAY_CNT);
       break;
@@ -182,20 +199,157 @@ int main(void) {
       //  pMEM[rxmemptr+i] = rx_words[i];
       //}
 
+      // Tell ARM caller I am done, and wake it if it is sleeping
+      // on the interrupt.
+      pMEM[0] = (uint32_t) 0x00;
+      __R31 = PRU0_ARM_INTERRUPT;
+
+      __delay_cycles(DELAY_CNT);
+      break;
+
+
+    //-------------------------------------------------------------
+    case SPI_STREAM:
+      // Tell ARM caller I am working on it.
+      pMEM[0] = (uint32_t) 0xee;
+
+      tx_word_cnt = pMEM[memptr++];
+      for (i=0; i<tx_word_cnt; i++) {
+        tx_words[i] = pMEM[memptr++];
+      }
+      rx_word_cnt = pMEM[memptr++];   // Number of bytes in one conversion value
+      ncnv = pMEM[memptr++];          // Conversions per half buffer
+
+      // Ping-pong between the two halves until told to stop.  The
+      // A/D keeps converting in continuous mode the whole time, and
+      // the turnaround between halves is a few dozen cycles, far
+      // less than one conversion period, so the next call still
+      // catches the next DOUT/RDY and no sample is lost.
+      half = 0;
+      while (!pMEM[STREAM_STOP]) {
+        if (pMEM[STREAM_FULL0+half]) {
+          pMEM[STREAM_OVERRUN]++;
+        }
+        pru_spi_writeread_continuous(tx_words, tx_word_cnt,
+                                     &(pMEM[STREAM_DATA+half*ncnv]), rx_word_cnt, ncnv);
+        pMEM[STREAM_FULL0+half] = 1;
+        __R31 = PRU0_ARM_INTERRUPT;
+        half ^= 1;
+      }
+
       // Tell ARM caller I am done.
       pMEM[0] = (uint32_t) 0x00;
+      __R31 = PRU0_ARM_INTERRUPT;
 
       __delay_cycles(DELAY_CNT);
       break;
 
+    //-------------------------------------------------------------
+    case SPI_RING:
+      // Tell ARM caller I am working on it.
+      pMEM[0] = (uint32_t) 0xee;
+
+      tx_word_cnt = pMEM[memptr++];
+      for (i=0; i<tx_word_cnt; i++) {
+        tx_words[i] = pMEM[memptr++];
+      }
+      rx_word_cnt = pMEM[memptr++];   // Number of bytes in one conversion value
+      pRing = (volatile uint32_t *) pMEM[memptr++];   // Physical address of ring
+
+      // Write straight into DDR a chunk at a time.  The host set up
+      // SIZE as a multiple of RING_CHUNK, so a chunk never wraps.
+      // HEAD is only advanced once the chunk is in.
+      mask = pRing[RING_SIZE] - 1;
+      head = 0;
+      while (!pMEM[STREAM_STOP]) {
+        if ((mask + 1) - (head - pRing[RING_TAIL]) < RING_CHUNK) {
+          // Host has fallen behind.  Keep the A/D's pace, but read
+          // into our own RAM and drop the chunk.
+          pru_spi_writeread_continuous(tx_words, tx_word_cnt,
+                                       &(pMEM[STREAM_DATA]), rx_word_cnt, RING_CHUNK);
+          pRing[RING_OVERRUN] += RING_CHUNK;
+        } else {
+          pru_spi_writeread_continuous(tx_words, tx_word_cnt,
+                                       &(pRing[RING_DATA + (head & mask)]), rx_word_cnt, RING_CHUNK);
+          head += RING_CHUNK;
+          pRing[RING_HEAD] = head;
+        }
+        __R31 = PRU0_ARM_INTERRUPT;
+      }
+
+      // Tell ARM caller I am done.
+      pMEM[0] = (uint32_t) 0x00;
+      __R31 = PRU0_ARM_INTERRUPT;
+
+      __delay_cycles(DELAY_CNT);
+      break;
+
+    //-------------------------------------------------------------
+    case SPI_CMDLIST:
+      // Tell ARM caller I am working on it.
+      pMEM[0] = (uint32_t) 0xee;
+
+      // Run each entry in turn.  Same calls as the single commands
+      // above, minus the handshake in between.
+      ncmd = pMEM[memptr++];
+      for (c=0; c<ncmd; c++) {
+        switch (pMEM[memptr++]) {
+        case LIST_WRITE:
+          tx_word_cnt = pMEM[memptr++];
+          for (i=0; i<tx_word_cnt; i++) {
+            tx_words[i] = pMEM[memptr++];
+          }
+          pru_spi_write(tx_words, tx_word_cnt);
+          __delay_cycles(DELAY_CNT);
+          break;
+
+        case LIST_WRITEREAD:
+          tx_word_cnt = pMEM[memptr++];
+          for (i=0; i<tx_word_cnt; i++) {
+            tx_words[i] = pMEM[memptr++];
+          }
+          rx_word_cnt = pMEM[memptr++];
+          pru_spi_writeread_single(tx_words, tx_word_cnt, rx_words, rx_word_cnt);
+          pMEM[memptr++] = rx_words[0];
+          __delay_cycles(DELAY_CNT);
+          break;
+
+        case LIST_DELAY:
+          // __delay_cycles wants a constant, so count microseconds.
+          for (i=pMEM[memptr++]; i>0; i--) {
+            __delay_cycles(CYCLES_PER_US);
+          }
+          break;
+
+        case LIST_RESET:
+          pru_spi_reset();
+          break;
+
+        default:
+          // Bad op.  Can't tell where the next entry starts, so
+          // stop here.
+          c = ncmd;
+          break;
+        }
+      }
+
+      // Tell ARM caller I am done, and wake it if it is sleeping
+      // on the interrupt.
+      pMEM[0] = (uint32_t) 0x00;
+      __R31 = PRU0_ARM_INTERRUPT;
+
+      __delay_cycles(DELAY_CNT);
+      break;
 
     //----------------------------------------------------------
     case SPI_RESET:
      // Tell ARM caller I am working on it.
       pMEM[0] = (uint32_t) 0xee;
       pru_spi_reset();
-      // Tell ARM caller I am done.
+      // Tell ARM caller I am done, and wake it if it is sleeping
+      // on the interrupt.
       pMEM[0] = (uint32_t) 0x00;
+      __R31 = PRU0_ARM_INTERRUPT;
       break;
 
     //----------------------------------------------------------
@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <signal.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+
+#include "spidriver_host.h"
+#include "adcdriver_host.h"
+#include "timer.h"
+
+// This program measures what it costs the host to get a frame of
+// samples out of PRU0:  with the old per-word msync() access to
+// shared RAM, with the barrier-based block transfers, and with the
+// block transfers plus sleeping on the PRU interrupt instead of
+// spinning.  The CPU time column is what the ARM actually burned;
+// the rest of each frame is free for the MUSIC computation.  It
+// reads real frames from the A/D, so it needs the cape and the PRU
+// firmware just like main.  The syscall counts are the driver's
+// own; run it under "strace -c" to check them.  Last it times a
+// burst of register writes sent one command at a time, the way
+// adc_config used to, against the same writes in one command list.
+
+// Default number of frames and samples per frame.
+#define BENCH_NFRAMES 100
+#define BENCH_NPTS 128
+
+// Register writes per configuration burst, and the GPIOCON reg
+// they write.  Writing it with 0x0000, as adc_config does, leaves
+// the A/D as it was.
+#define BENCH_NWRITES 6
+#define WRITE_GPIOCON_REG 0x06
+
+//===========================================================
+//-----------------------------------------------------
+void usage(char *progname) {
+  printf("Usage: %s [-n nframes] [-N npts]\n", progname);
+  printf("  -n  number of frames read in each mode.  Default %d.\n", BENCH_NFRAMES);
+  printf("  -N  samples per frame, up to 1024.  Default %d.\n", BENCH_NPTS);
+}
+
+
+//-----------------------------------------------------
+// Called when Ctrl+C is pressed - triggers the program to stop.
+void stopHandler(int sig) {
+  adc_quit();
+  exit(0);
+}
+
+
+//===========================================================
+int main(int argc, char *argv[]) {
+  int opt;
+  int nframes = BENCH_NFRAMES;
+  int npts = BENCH_NPTS;
+  int i, k;
+  float v[1024];
+  struct timespec tstart;
+  float telapsed, tcpu;
+  struct timespec cstart, cend;
+  pru_stats st;
+  const int sync_modes[3] = {PRU_SYNC_MSYNC, PRU_SYNC_BARRIER, PRU_SYNC_BARRIER};
+  const int done_modes[3] = {PRU_DONE_POLL, PRU_DONE_POLL, PRU_DONE_IRQ};
+  const char *names[3] = {"msync", "barrier", "irq"};
+  uint32_t tx_buf[3] = {WRITE_GPIOCON_REG, 0x00, 0x00};
+  spi_cmdlist l;
+  float tsep, tlist;
+
+  while ((opt = getopt(argc, argv, "n:N:h")) != -1) {
+    switch (opt) {
+    case 'n':
+      nframes = atoi(optarg);
+      break;
+    case 'N':
+      npts = atoi(optarg);
+      break;
+    default:
+      usage(argv[0]);
+      exit(EXIT_FAILURE);
+    }
+  }
+  if ((nframes < 1) || (npts < 1) || (npts > 1024)) {
+    usage(argv[0]);
+    exit(EXIT_FAILURE);
+  }
+
+  signal(SIGINT, stopHandler);
+
+  adc_config();
+  adc_set_samplerate(SAMP_RATE_15625);
+  adc_set_chan0();
+
+  printf("%d frames of %d samples per mode\n", nframes, npts);
+  printf("%-8s %12s %10s %10s %10s %10s %10s %6s\n", "mode", "syscalls/frm",
+         "polls/frm", "sleeps/frm", "words/frm", "us/frm", "cpu us/frm", "cpu %");
+  for (k = 0; k < 3; k++) {
+    pru_set_sync(sync_modes[k]);
+    pru_set_completion(done_modes[k]);
+
+    // One frame to settle before counting.
+    adc_read_multiple(npts, v);
+
+    pru_clear_stats();
+    timer_start(&tstart);
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cstart);
+    for (i = 0; i < nframes; i++) {
+      adc_read_multiple(npts, v);
+    }
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cend);
+    telapsed = timer_elapsed_us(&tstart);
+    tcpu = (cend.tv_sec - cstart.tv_sec)*1.0e6f + (cend.tv_nsec - cstart.tv_nsec)*1.0e-3f;
+    pru_get_stats(&st);
+
+    printf("%-8s %12.1f %10.1f %10.1f %10.1f %10.1f %10.1f %6.1f\n", names[k],
+           (float) st.syscalls/nframes, (float) st.polls/nframes,
+           (float) st.sleeps/nframes, (float) st.words/nframes,
+           telapsed/nframes, tcpu/nframes, 100.0f*tcpu/telapsed);
+  }
+
+  // Configuration latency.  Both ways use polling, barriers and
+  // the same 5 us gap between writes.
+  pru_set_sync(PRU_SYNC_BARRIER);
+  pru_set_completion(PRU_DONE_POLL);
+  timer_start(&tstart);
+  for (i = 0; i < nframes; i++) {
+    for (k = 0; k < BENCH_NWRITES; k++) {
+      spi_write_cmd(tx_buf, 3);
+      usleep(5);
+    }
+  }
+  tsep = timer_elapsed_us(&tstart);
+
+  spi_list_init(&l);
+  for (k = 0; k < BENCH_NWRITES; k++) {
+    spi_list_write(&l, tx_buf, 3);
+    spi_list_delay(&l, 5);
+  }
+  timer_start(&tstart);
+  for (i = 0; i < nframes; i++) {
+    spi_list_run(&l);
+  }
+  tlist = timer_elapsed_us(&tstart);
+
+  printf("\n%d register writes:  %.1f us one at a time, %.1f us as one list\n",
+         BENCH_NWRITES, tsep/nframes, tlist/nframes);
+
+  adc_quit();
+  return 0;
+}
@@ -11,6 +11,8 @@
 #include <stdio.h>
 #include <sys/mman.h>
 #include <unistd.h>
+#include <poll.h>
+#include <errno.h>
 
 #include <prussdrv.h>
 #include <pruss_intc_mapping.h>
@@ -21,6 +23,36 @@
 #define PRU0 0
 #define PRU1 1
 
+// Full memory barrier.  The UIO mapping of PRU RAM is uncached
+// device memory, so there is no cache to write back and msync() on
+// it buys nothing but a syscall.  What we do need is ordering:  the
+// message words must land before the flag that starts the PRU, and
+// the flag must be seen clear before the results are read.
+#if defined(__arm__)
+#define PRU_BARRIER() __asm__ __volatile__ ("dmb" : : : "memory")
+#else
+#define PRU_BARRIER() __sync_synchronize()
+#endif
+
+// How shared RAM is accessed, see pru_set_sync, how we wait for
+// the PRU to finish a command, see pru_set_completion, and counts
+// of what it cost.
+static int sync_mode = PRU_SYNC_BARRIER;
+static int done_mode = PRU_DONE_POLL;
+static pru_stats stats;
+
+// State of the ping-pong stream, see spi_stream_start.
+static int stream_n;           // Conversions per half
+static int stream_half;        // Half to read next
+static uint32_t stream_overruns;
+
+// State of the DDR ring, see spi_ring_start.  ring_tail is our copy
+// of the tail index, which only we write.
+static volatile uint32_t *ring;
+static uint32_t ring_mask;
+static uint32_t ring_tail;
+static uint32_t ring_overruns;
+
 //=====================================================================
 uint8_t pruss_init(void) {
   // This initializes the PRUSS driver stuff, and sets up the
@@ -113,38 +145,62 @@ uint8_t pru_reset(int prunum) {
 
 //---------------------------------------------------------------------------
 void spi_reset_cmd(void) {
-  int i;
-  int N;
-  volatile uint32_t tmp;
   printf("Sending reset command to PRU.....\n");
 
-  pru_write_word(0, SPI_RESET);
+  pru_start_cmd(SPI_RESET);
 
   // Now wait until write is complete.
-  N = 10000000;
-  for (i=0; i<N; i++) {
-    tmp = pru_read_word(0x00);
-    // printf("...tmp = %d\n", tmp);
-    if (!tmp) {
-      break;
-    }
-  }
-  // printf("In spi_reset_cmd, at end of waiting, i = %d, tmp = %d\n", i, tmp);
+  pru_wait_done();
+}
+
+//--------------------------------------------------------------
+void pru_set_sync(int mode) {
+  // Select how shared RAM is accessed.  PRU_SYNC_BARRIER (default)
+  // uses plain loads and stores ordered by barriers.  PRU_SYNC_MSYNC
+  // is the old scheme, one msync() per word, kept so the two can
+  // be benchmarked against each other.
+  sync_mode = mode;
+}
+
+//--------------------------------------------------------------
+void pru_set_completion(int mode) {
+  // Select how to wait for the PRU to finish a command.
+  // PRU_DONE_POLL (default) spins on the command flag.  PRU_DONE_IRQ
+  // sleeps in poll() on the UIO event fd until the PRU raises
+  // PRU0_ARM_INTERRUPT, which leaves the ARM free while the A/D
+  // converts.
+  done_mode = mode;
+}
+
+//--------------------------------------------------------------
+void pru_get_stats(pru_stats *s) {
+  *s = stats;
+}
+
+//--------------------------------------------------------------
+void pru_clear_stats(void) {
+  stats.syscalls = 0;
+  stats.polls = 0;
+  stats.sleeps = 0;
+  stats.words = 0;
 }
 
 //--------------------------------------------------------------
 uint32_t pru_read_word(uint32_t offset) {
-  // Must make these volatile so compiler evaluates them
-  // every time this fcn is called.
-  uint32_t *mem_ptr;
-  uint32_t *mem_ptr_32;
-  const uint32_t ram_offset = RAMOFFSET;
+  // Must make the pointer volatile so the compiler reads the RAM
+  // every time this fcn is called.  The barrier after the load
+  // keeps later reads from being done before it.
+  volatile uint32_t *mem_ptr_32;
   uint32_t retval;
 
-  mem_ptr = pru0_dataram;
-  mem_ptr_32 = mem_ptr + ram_offset + offset;
-  msync(mem_ptr_32, 1, MS_SYNC);
+  mem_ptr_32 = pru0_dataram + RAMOFFSET + offset;
+  if (sync_mode == PRU_SYNC_MSYNC) {
+    msync((void *) mem_ptr_32, 1, MS_SYNC);
+    stats.syscalls++;
+  }
   retval = *mem_ptr_32;
+  PRU_BARRIER();
+  stats.words++;
 
   //printf("--> In pru_read_word, just read 0x%08x\n", retval);
 
@@ -153,19 +209,189 @@ uint32_t pru_read_word(uint32_t offset) {
 
 //--------------------------------------------------------------
 void pru_write_word(uint32_t offset, uint32_t value) {
-  uint32_t *mem_ptr;
-  uint32_t *mem_ptr_32;
-  const uint32_t ram_offset = RAMOFFSET;
+  // The barrier before the store makes sure everything written
+  // earlier lands first, which is what the PRU relies on when
+  // value is a command flag.
+  volatile uint32_t *mem_ptr_32;
 
-  mem_ptr = pru0_dataram;
-  mem_ptr_32 = mem_ptr + ram_offset + offset;
+  mem_ptr_32 = pru0_dataram + RAMOFFSET + offset;
+  PRU_BARRIER();
   *mem_ptr_32 = value;
-  msync(mem_ptr_32, 1, MS_SYNC);
+  if (sync_mode == PRU_SYNC_MSYNC) {
+    msync((void *) mem_ptr_32, 1, MS_SYNC);
+    stats.syscalls++;
+  }
+  stats.words++;
 
   //printf("--> In pru_write_word, just wrote 0x%08x\n", value);
 
 }
 
+//--------------------------------------------------------------
+void pru_read_block(uint32_t offset, uint32_t *dst, int n) {
+  // Copy n words out of PRU RAM starting at offset.  This is a
+  // memcpy, but done as 32 bit volatile loads:  libc memcpy may use
+  // byte, unaligned or NEON accesses, which device memory doesn't
+  // take kindly to.  One barrier orders the whole block.
+  volatile uint32_t *src;
+  int i;
+
+  if (sync_mode == PRU_SYNC_MSYNC) {
+    for (i = 0; i < n; i++) {
+      dst[i] = pru_read_word(offset+i);
+    }
+    return;
+  }
+  src = pru0_dataram + RAMOFFSET + offset;
+  for (i = 0; i < n; i++) {
+    dst[i] = src[i];
+  }
+  PRU_BARRIER();
+  stats.words += n;
+}
+
+//--------------------------------------------------------------
+void pru_write_block(uint32_t offset, const uint32_t *src, int n) {
+  // Copy n words into PRU RAM starting at offset.  Counterpart of
+  // pru_read_block.
+  volatile uint32_t *dst;
+  int i;
+
+  if (sync_mode == PRU_SYNC_MSYNC) {
+    for (i = 0; i < n; i++) {
+      pru_write_word(offset+i, src[i]);
+    }
+    return;
+  }
+  dst = pru0_dataram + RAMOFFSET + offset;
+  PRU_BARRIER();
+  for (i = 0; i < n; i++) {
+    dst[i] = src[i];
+  }
+  stats.words += n;
+}
+
+//--------------------------------------------------------------
+int pru_wait_flag(uint32_t offset, uint32_t maxpolls) {
+  // Spin until the word at offset reads zero, which is how the PRU
+  // says it is done.  Each poll is one load, no syscall.  Returns
+  // the number of polls taken, or -1 after maxpolls.
+  uint32_t i;
+
+  for (i = 0; i < maxpolls; i++) {
+    stats.polls++;
+    if (!pru_read_word(offset)) {
+      return i;
+    }
+  }
+  return -1;
+}
+
+//--------------------------------------------------------------
+static void pru_arm_irq(void) {
+  // The PRU raises its completion interrupt after every command,
+  // including the ones we polled for, and UIO disables the host
+  // interrupt each time it fires.  So before sleeping on it, throw
+  // away any count UIO is holding from earlier, then clear the
+  // system event, which also re-enables the host interrupt.  An
+  // interrupt raised after that is held by UIO until we read it,
+  // so there is no window to miss it in.
+  struct pollfd pfd;
+  uint32_t count;
+
+  pfd.fd = prussdrv_pru_event_fd(PRU_EVTOUT_0);
+  pfd.events = POLLIN;
+  stats.syscalls++;
+  if (poll(&pfd, 1, 0) > 0) {
+    if (read(pfd.fd, &count, sizeof(count)) != sizeof(count)) {
+      // The stale count is still pending, so the next sleep
+      // returns at once and we end up polling the flag instead.
+      // Slower, but still correct.
+    }
+    stats.syscalls++;
+  }
+  prussdrv_pru_clear_event(PRU_EVTOUT_0, PRU0_ARM_INTERRUPT);
+}
+
+//--------------------------------------------------------------
+static int pru_sleep_irq(void) {
+  // Sleep until the PRU interrupts.  Returns 0 when it has, -1 on
+  // timeout or if the event count can't be read.
+  struct pollfd pfd;
+  uint32_t count;
+  int ret;
+
+  pfd.fd = prussdrv_pru_event_fd(PRU_EVTOUT_0);
+  pfd.events = POLLIN;
+  do {
+    ret = poll(&pfd, 1, PRU_IRQ_TIMEOUT_MS);
+    stats.syscalls++;
+  } while ((ret < 0) && (errno == EINTR));
+  stats.sleeps++;
+  if (ret <= 0) {
+    return -1;
+  }
+  stats.syscalls++;
+  if (read(pfd.fd, &count, sizeof(count)) != sizeof(count)) {
+    return -1;
+  }
+  return 0;
+}
+
+//--------------------------------------------------------------
+void pru_start_cmd(uint32_t flag) {
+  // Hand the PRU the command flag, once the message is in place.
+  if (done_mode == PRU_DONE_IRQ) {
+    pru_arm_irq();
+  }
+  pru_write_word(0, flag);
+}
+
+//--------------------------------------------------------------
+int pru_wait_done(void) {
+  // Wait for the PRU to finish the command started by
+  // pru_start_cmd.  Returns 0 when it has, -1 on timeout.
+  if (done_mode == PRU_DONE_IRQ) {
+    if (pru_sleep_irq() < 0) {
+      return -1;
+    }
+  }
+
+  // With the interrupt, the PRU cleared the flag just before
+  // raising it, so this succeeds on the first poll.
+  return (pru_wait_flag(0x00, PRU_MAXPOLLS) < 0) ? -1 : 0;
+}
+
+//--------------------------------------------------------------
+int pru_wait_set(uint32_t offset) {
+  // Wait for the word at offset to go nonzero, which is how the
+  // PRU says a stream buffer is full.  Unlike the command flag the
+  // PRU keeps running afterwards, so with the interrupt we have to
+  // look at the word after arming, and only sleep if it isn't set
+  // yet.  Returns 0 when it is set, -1 on timeout.
+  uint32_t i;
+
+  if (done_mode == PRU_DONE_IRQ) {
+    while (1) {
+      pru_arm_irq();
+      stats.polls++;
+      if (pru_read_word(offset)) {
+        return 0;
+      }
+      if (pru_sleep_irq() < 0) {
+        return -1;
+      }
+    }
+  }
+
+  for (i = 0; i < PRU_MAXPOLLS; i++) {
+    stats.polls++;
+    if (pru_read_word(offset)) {
+      return 0;
+    }
+  }
+  return -1;
+}
 
 //--------------------------------------------------------------
 uint32_t pru_test_ram(uint32_t offset, uint32_t value) {
@@ -200,7 +426,6 @@ uint32_t pru_test_ram(uint32_t offset, uint32_t value) {
 uint32_t pru_test_communication(void) {
   int i;
   int N;
-  volatile uint32_t tmp;
   
   // Now give it flag so it can go and do its thing
   printf("------> Entered pru_test_communication....\n");
@@ -209,14 +434,11 @@ uint32_t pru_test_communication(void) {
 
   // Now wait until write is complete.
   N = 1000000;
-  for (i=0; i<N; i++) {
-    tmp = pru_read_word(0x00);
-    // printf("...tmp = %d\n", tmp);
-    if (!tmp) {
-      break;
-    }
+  i = pru_wait_flag(0x00, N);
+  if (i < 0) {
+    i = N;
   }
-  printf("          In pru_test_communication, at end of waiting, i = %d, tmp = %d\n", i, tmp);
+  printf("          In pru_test_communication, at end of waiting, i = %d\n", i);
   if (i == N) {
     printf("        Communications test failed!\n");
   } else {
@@ -245,41 +467,33 @@ uint32_t spi_write_cmd(uint32_t *data, int word_cnt) {
   */
 
   uint32_t i;
-  volatile uint32_t tmp;
+  uint32_t msg[2+word_cnt];
   uint32_t mem_ptr = 0x00;
-  uint32_t N;
 
   // printf("--> In spi_write_cmd, writing %d words\n", word_cnt);
 
-  // First set up PRU0 memory with data I want to transmit
-  pru_write_word(mem_ptr++, 0xff);
-  pru_write_word(mem_ptr++, word_cnt);
-
+  // First set up PRU0 memory with data I want to transmit.  The
+  // whole message goes over in one block.
+  msg[mem_ptr++] = 0xff;
+  msg[mem_ptr++] = word_cnt;
   for (i = 0; i < word_cnt; i++) {
-    pru_write_word(mem_ptr++, data[i]);
+    msg[mem_ptr++] = data[i];
     // printf("   Tx byte %d = 0x%08x\n", i, data[i]);
   }
+  pru_write_block(0, msg, mem_ptr);
 
   // Now give it flag so it can go and do its thing
   // printf("Send SPI_WRITE to PRU to do execute SPI write...\n");
-  pru_write_word(0, SPI_WRITE);
+  pru_start_cmd(SPI_WRITE);
 
   // Now wait until write is complete.
-  N = 10000000;
-  for (i=0; i<N; i++) {
-    tmp = pru_read_word(0x00);
-    if (!tmp) {
-      break;
-    }
-  }
-  if (i == N) {
+  if (pru_wait_done() < 0) {
     printf("In spi_write_cmd, timed out waiting for end of transaction!\n");
     pru_reset(PRU0);
     prussdrv_exit();
     exit(-1);
   }
  
-  // printf("In spi_write_cmd, at end of waiting, i = %d, tmp = %d\n", i, tmp);
   return retval;
 
 }
@@ -304,51 +518,39 @@ uint8_t spi_writeread_single(uint32_t *txdata, int txcnt, uint32_t *rxdata, int
   */
 
   uint32_t i;
-  volatile int tmp;
+  uint32_t msg[3+txcnt+rxcnt];
   uint32_t memptr = 0x00;
   uint32_t rxptr;
-  uint32_t N;
 
   // printf("--> In spi_writeread_single, writing %d words\n", txcnt);
 
   // Set up transmitted data
-  pru_write_word(memptr++, 0xff);      // Put PRU in "Wait for command" mode
-  pru_write_word(memptr++, txcnt);     // Number of tx bytes to send.
+  msg[memptr++] = 0xff;      // Put PRU in "Wait for command" mode
+  msg[memptr++] = txcnt;     // Number of tx bytes to send.
   for (i = 0; i < txcnt; i++) {
-    pru_write_word(memptr++, (uint32_t) txdata[i]);
+    msg[memptr++] = txdata[i];
     // printf("   Tx byte %d = 0x%08x\n", i, txdata[i]);
   }
 
   // Set up receive buffer
-  pru_write_word(memptr++, rxcnt);
+  msg[memptr++] = rxcnt;
   rxptr = memptr;                  // This points to begin of rx data.
   for (i = 0; i < rxcnt; i++) {
-    pru_write_word(memptr++, (uint32_t) 0x00);
+    msg[memptr++] = 0x00;
   }
+  pru_write_block(0, msg, memptr);
 
   // Now send the instruction flag.
-  pru_write_word(0, SPI_WRITEREAD_SINGLE);
+  pru_start_cmd(SPI_WRITEREAD_SINGLE);
 
   // Wait for transaction to complete.
-  N = 10000000;
-  // N = 100;
-  for (i=0; i<N; i++) {
-    tmp = pru_read_word(0x00);
-    // printf("In spi_writeread_single, tmp = 0x%08x\n", tmp);
-    if (!(tmp)) {
-      break;
-    }
-  }
-  if (i == N) {
+  if (pru_wait_done() < 0) {
     printf("In spi_writeread_single, timed out waiting for end of transaction!\n");
     pru_reset(PRU0);
     prussdrv_exit();
     exit(-1); 
   } 
 
-  // printf("After waiting for SPI_WRITEREAD_SINGLE, i = %d, tmp = 0x%02x\n", i, tmp);
-
-
   // At end of transaction, the received data should be placed into
   // rx_data.
   rxdata[0] = pru_read_word(rxptr);
@@ -374,59 +576,416 @@ uint8_t spi_writeread_continuous(uint32_t *txdata, int txcnt, uint32_t *rxdata,
   */
 
   uint32_t i;
-  volatile int tmp;
+  uint32_t msg[4+txcnt+ncnv];
   uint32_t memptr = 0x00;
   uint32_t rxptr;
-  uint32_t N;
 
   // printf("--> In spi_writeread_continuous, writing %d bytes\n", txcnt);
 
   // Set up transmitted data
-  pru_write_word(memptr++, 0xff);      // Put PRU in "Wait for command" mode
-  pru_write_word(memptr++, txcnt);     // Number of tx bytes to send.
+  msg[memptr++] = 0xff;      // Put PRU in "Wait for command" mode
+  msg[memptr++] = txcnt;     // Number of tx bytes to send.
   for (i = 0; i < txcnt; i++) {
-    pru_write_word(memptr++, txdata[i]);
+    msg[memptr++] = txdata[i];
     // printf("   Tx word %d = 0x%08x\n", i, txdata[i]);
   }
 
   // Set up receive buffer
-  pru_write_word(memptr++, rxcnt);  // Number of bytes in one conversion value
-  pru_write_word(memptr++, ncnv);   // Total number of conversions requested
-  rxptr = memptr;                   // This points to begin of rx data.
+  msg[memptr++] = rxcnt;  // Number of bytes in one conversion value
+  msg[memptr++] = ncnv;   // Total number of conversions requested
+  rxptr = memptr;         // This points to begin of rx data.
   for (i = 0; i < ncnv; i++) {
-    pru_write_word(memptr++, 0x00);
+    msg[memptr++] = 0x00;
   }
+  pru_write_block(0, msg, memptr);
 
   // Now send the instruction flag.
-  pru_write_word(0, SPI_WRITEREAD_CONTINUOUS);
+  pru_start_cmd(SPI_WRITEREAD_CONTINUOUS);
 
   // Wait for transaction to complete.
-  N = 10000000;
-  for (i=0; i<N; i++) {
-    tmp = pru_read_word(0x00);
-    // printf("In spi_writeread_continuous, tmp = 0x%08x\n", tmp);
-    if (!(tmp)) {
-      break;
-    }
-  }
-  if (i == N) {
+  if (pru_wait_done() < 0) {
     printf("In spi_writeread_continuous, timed out waiting for end of transaction!\n");
     pru_reset(PRU0);
     prussdrv_exit();
     exit(-1); 
   } 
- 
-  // printf("After waiting for SPI_WRITEREAD_CONTINUOUS, i = %d, tmp = 0x%02x\n", i, tmp);
-
 
   // At end of transaction, the received data should be placed into
-  // rx_data.
-  for (i = 0; i < ncnv; i++) {    
-    rxdata[i] = pru_read_word(rxptr+i);
-    // printf("   Rx word %d = 0x%08x\n", i, rxdata[i]);
-  } 
+  // rx_data.  Pull it all back in one block.
+  pru_read_block(rxptr, rxdata, ncnv);
 
   // May want to return number of received words here
   return ncnv;
 }
 
+
+//---------------------------------------------------------------------------
+uint8_t spi_stream_start(uint32_t *txdata, int txcnt, int rxcnt, int nhalf) {
+  // Start gapless acquisition.  The PRU issues txdata before every
+  // conversion, as spi_writeread_continuous does, but never stops:
+  // it fills the two halves of the stream buffer in turn, nhalf
+  // conversions each, until spi_stream_stop.  Collect the halves
+  // in order with spi_stream_read.  Nothing else may be sent to the
+  // PRU while the stream runs.
+
+  /* Command message structure is:
+  uint32_t flag -- specifying what command to do
+  uint32_t tx_byte_count
+  uint32_t tx_data[<tx_byte_count>]
+  uint32_t rx_byte_count
+  uint32_t nhalf
+  and the control words at STREAM_STOP, see pru_spi.h.
+  */
+
+  uint32_t i;
+  uint32_t msg[4+txcnt];
+  uint32_t ctl[STREAM_OVERRUN-STREAM_STOP+1];
+  uint32_t memptr = 0x00;
+
+  if ((nhalf < 1) || (nhalf > STREAM_MAXHALF) || (txcnt > 4)) {
+    printf("In spi_stream_start, need nhalf <= %d and txcnt <= 4.\n", STREAM_MAXHALF);
+    return 1;
+  }
+
+  msg[memptr++] = 0xff;      // Put PRU in "Wait for command" mode
+  msg[memptr++] = txcnt;     // Number of tx bytes to send.
+  for (i = 0; i < txcnt; i++) {
+    msg[memptr++] = txdata[i];
+  }
+  msg[memptr++] = rxcnt;     // Number of bytes in one conversion value
+  msg[memptr++] = nhalf;     // Conversions per half
+  pru_write_block(0, msg, memptr);
+
+  // Clear stop, both full flags and the overrun count.
+  for (i = 0; i <= STREAM_OVERRUN-STREAM_STOP; i++) {
+    ctl[i] = 0;
+  }
+  pru_write_block(STREAM_STOP, ctl, STREAM_OVERRUN-STREAM_STOP+1);
+
+  stream_n = nhalf;
+  stream_half = 0;
+  stream_overruns = 0;
+  pru_start_cmd(SPI_STREAM);
+  return 0;
+}
+
+
+//---------------------------------------------------------------------------
+int spi_stream_read(uint32_t *rxdata) {
+  // Wait for the next half of the stream to fill, copy its nhalf
+  // words into rxdata and hand the half back to the PRU.  While we
+  // copy and the caller works on the data, the PRU is filling the
+  // other half.  Returns how many halves the PRU has had to
+  // overwrite unread since the last call, i.e. 0 unless the caller
+  // takes longer than a half to come back.
+  uint32_t ov, nov;
+
+  if (pru_wait_set(STREAM_FULL0+stream_half) < 0) {
+    printf("In spi_stream_read, timed out waiting for data!\n");
+    pru_reset(PRU0);
+    prussdrv_exit();
+    exit(-1);
+  }
+  pru_read_block(STREAM_DATA+stream_half*stream_n, rxdata, stream_n);
+  pru_write_word(STREAM_FULL0+stream_half, 0);
+  stream_half ^= 1;
+
+  ov = pru_read_word(STREAM_OVERRUN);
+  nov = ov - stream_overruns;
+  stream_overruns = ov;
+  return nov;
+}
+
+
+//---------------------------------------------------------------------------
+void spi_stream_stop(void) {
+  // Ask the PRU to stop streaming.  It finishes the half it is on
+  // first, so this can take up to one half's worth of conversions.
+  pru_write_word(STREAM_STOP, 1);
+  if (pru_wait_flag(0x00, PRU_MAXPOLLS) < 0) {
+    printf("In spi_stream_stop, timed out waiting for end of stream!\n");
+    pru_reset(PRU0);
+    prussdrv_exit();
+    exit(-1);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+uint32_t spi_ring_start(uint32_t *txdata, int txcnt, int rxcnt) {
+  // Start gapless acquisition into a ring buffer in the DDR pool
+  // uio_pruss shares with the PRUs (extram_pool_sz, 256 kB unless
+  // set otherwise).  The PRU writes conversions straight into DDR,
+  // so reads aren't limited by the 8 kB PRU RAM and nothing is
+  // staged through it.  Collect samples with spi_ring_wait,
+  // spi_ring_buf and spi_ring_release.  Nothing else may be sent to
+  // the PRU while the ring runs.  Returns the ring length in
+  // samples, or 0 if there is no usable pool.
+
+  /* Command message structure is:
+  uint32_t flag -- specifying what command to do
+  uint32_t tx_byte_count
+  uint32_t tx_data[<tx_byte_count>]
+  uint32_t rx_byte_count
+  uint32_t ring physical address
+  and the ring header in DDR, see pru_spi.h.
+  */
+
+  uint32_t i;
+  uint32_t msg[4+txcnt];
+  uint32_t memptr = 0x00;
+  void *ext;
+  uint32_t nwords, size;
+
+  if ((prussdrv_map_extmem(&ext) != 0) || (ext == NULL) || (txcnt > 4)) {
+    printf("In spi_ring_start, no external memory mapped.\n");
+    return 0;
+  }
+  nwords = prussdrv_extmem_size()/sizeof(uint32_t);
+  if (nwords < RING_DATA + RING_CHUNK) {
+    printf("In spi_ring_start, external memory too small.\n");
+    return 0;
+  }
+
+  // Largest power of two that fits.  It is a multiple of RING_CHUNK,
+  // so the PRU never has to wrap in the middle of a chunk.
+  for (size = RING_CHUNK; 2*size <= nwords - RING_DATA; size *= 2) ;
+
+  ring = (volatile uint32_t *) ext;
+  ring_mask = size - 1;
+  ring_tail = 0;
+  ring_overruns = 0;
+  ring[RING_HEAD] = 0;
+  ring[RING_TAIL] = 0;
+  ring[RING_SIZE] = size;
+  ring[RING_OVERRUN] = 0;
+
+  msg[memptr++] = 0xff;      // Put PRU in "Wait for command" mode
+  msg[memptr++] = txcnt;     // Number of tx bytes to send.
+  for (i = 0; i < txcnt; i++) {
+    msg[memptr++] = txdata[i];
+  }
+  msg[memptr++] = rxcnt;     // Number of bytes in one conversion value
+  msg[memptr++] = prussdrv_get_phys_addr(ext);
+  pru_write_block(0, msg, memptr);
+  pru_write_word(STREAM_STOP, 0);
+
+  // pru_start_cmd's barrier also orders the ring header ahead of
+  // the flag.
+  pru_start_cmd(SPI_RING);
+  return size;
+}
+
+
+//---------------------------------------------------------------------------
+int spi_ring_wait(uint32_t n) {
+  // Wait until at least n samples past the tail are in the ring.
+  // The PRU delivers a chunk every RING_CHUNK conversions, so we
+  // only call it hung if the head stops moving altogether.  Returns
+  // the number of samples the PRU has had to drop since the last
+  // call because the ring was full, normally 0.
+  uint32_t head, last, ov, nov;
+  uint32_t i;
+
+  if (n > ring_mask+1) {
+    printf("In spi_ring_wait, asked for %u samples from a ring of %u.\n", n, ring_mask+1);
+    pru_reset(PRU0);
+    prussdrv_exit();
+    exit(-1);
+  }
+
+  last = ring_tail;
+  i = 0;
+  while (1) {
+    if (done_mode == PRU_DONE_IRQ) {
+      pru_arm_irq();
+    }
+    head = ring[RING_HEAD];
+    PRU_BARRIER();
+    stats.polls++;
+    if (head - ring_tail >= n) {
+      break;
+    }
+    if (head != last) {
+      last = head;
+      i = 0;
+    }
+    if (done_mode == PRU_DONE_IRQ) {
+      i = (pru_sleep_irq() < 0) ? PRU_MAXPOLLS : i;
+    } else {
+      i++;
+    }
+    if (i >= PRU_MAXPOLLS) {
+      printf("In spi_ring_wait, timed out waiting for data!\n");
+      pru_reset(PRU0);
+      prussdrv_exit();
+      exit(-1);
+    }
+  }
+
+  ov = ring[RING_OVERRUN];
+  nov = ov - ring_overruns;
+  ring_overruns = ov;
+  return nov;
+}
+
+
+//---------------------------------------------------------------------------
+const volatile uint32_t *spi_ring_buf(uint32_t *tail, uint32_t *mask) {
+  // The ring's data and how to index it:  the oldest unread sample
+  // is buf[*tail & *mask], the next at buf[(*tail+1) & *mask], and
+  // so on.  Reading in place saves copying the frame out first.
+  *tail = ring_tail;
+  *mask = ring_mask;
+  return ring + RING_DATA;
+}
+
+
+//---------------------------------------------------------------------------
+void spi_ring_release(uint32_t n) {
+  // Hand the oldest n samples back to the PRU.  The barrier makes
+  // sure we are done reading them before it can reuse the space.
+  ring_tail += n;
+  PRU_BARRIER();
+  ring[RING_TAIL] = ring_tail;
+}
+
+
+//---------------------------------------------------------------------------
+void spi_ring_stop(void) {
+  // Ask the PRU to stop filling the ring.  It finishes the chunk it
+  // is on first.
+  pru_write_word(STREAM_STOP, 1);
+  if (pru_wait_flag(0x00, PRU_MAXPOLLS) < 0) {
+    printf("In spi_ring_stop, timed out waiting for end of stream!\n");
+    pru_reset(PRU0);
+    prussdrv_exit();
+    exit(-1);
+  }
+}
+
+
+//---------------------------------------------------------------------------
+void spi_list_init(spi_cmdlist *l) {
+  l->nwords = 0;
+  l->ncmd = 0;
+  l->nread = 0;
+}
+
+
+//---------------------------------------------------------------------------
+static int list_room(spi_cmdlist *l, int n) {
+  // Check the next entry, n words long, fits.
+  if (l->nwords + n > LIST_MAXWORDS-2) {
+    printf("In spi_list, command list full!\n");
+    return 0;
+  }
+  return 1;
+}
+
+
+//---------------------------------------------------------------------------
+int spi_list_write(spi_cmdlist *l, const uint32_t *data, int word_cnt) {
+  // Append an SPI write of word_cnt words, as spi_write_cmd sends.
+  // Returns 0, or -1 if it doesn't fit.
+  int i;
+
+  if ((word_cnt > 4) || !list_room(l, 2+word_cnt)) {
+    return -1;
+  }
+  l->w[l->nwords++] = LIST_WRITE;
+  l->w[l->nwords++] = word_cnt;
+  for (i = 0; i < word_cnt; i++) {
+    l->w[l->nwords++] = data[i];
+  }
+  l->ncmd++;
+  return 0;
+}
+
+
+//---------------------------------------------------------------------------
+int spi_list_writeread(spi_cmdlist *l, const uint32_t *txdata, int txcnt, int rxcnt) {
+  // Append a write then read, as spi_writeread_single does.  Returns
+  // the index in l->w the result will land in, or -1 if it doesn't
+  // fit.
+  int i;
+
+  if ((txcnt > 4) || !list_room(l, 4+txcnt)) {
+    return -1;
+  }
+  l->w[l->nwords++] = LIST_WRITEREAD;
+  l->w[l->nwords++] = txcnt;
+  for (i = 0; i < txcnt; i++) {
+    l->w[l->nwords++] = txdata[i];
+  }
+  l->w[l->nwords++] = rxcnt;
+  l->w[l->nwords++] = 0x00;
+  l->ncmd++;
+  l->nread++;
+  return l->nwords-1;
+}
+
+
+//---------------------------------------------------------------------------
+int spi_list_delay(spi_cmdlist *l, uint32_t us) {
+  // Append a pause of us microseconds, timed on the PRU.
+  if (!list_room(l, 2)) {
+    return -1;
+  }
+  l->w[l->nwords++] = LIST_DELAY;
+  l->w[l->nwords++] = us;
+  l->ncmd++;
+  return 0;
+}
+
+
+//---------------------------------------------------------------------------
+int spi_list_reset(spi_cmdlist *l) {
+  // Append an A/D reset, as spi_reset_cmd sends.
+  if (!list_room(l, 1)) {
+    return -1;
+  }
+  l->w[l->nwords++] = LIST_RESET;
+  l->ncmd++;
+  return 0;
+}
+
+
+//---------------------------------------------------------------------------
+void spi_list_run(spi_cmdlist *l) {
+  // Send the whole list to the PRU as one SPI_CMDLIST command and
+  // wait for it to finish.  The transactions run back to back on
+  // the PRU, so instead of a handshake (and the host's scheduling
+  // slop) per transaction there is just the one.  If there were any
+  // reads, their results are copied back into l->w.
+
+  /* Command message structure is:
+  uint32_t flag -- specifying what command to do
+  uint32_t number of entries
+  uint32_t entries[], see pru_spi.h
+  */
+
+  uint32_t msg[2];
+
+  if (l->ncmd == 0) {
+    return;
+  }
+
+  msg[0] = 0xff;      // Put PRU in "Wait for command" mode
+  msg[1] = l->ncmd;
+  pru_write_block(0, msg, 2);
+  pru_write_block(2, l->w, l->nwords);
+
+  pru_start_cmd(SPI_CMDLIST);
+
+  if (pru_wait_done() < 0) {
+    printf("In spi_list_run, timed out waiting for end of transaction!\n");
+    pru_reset(PRU0);
+    prussdrv_exit();
+    exit(-1);
+  }
+
+  if (l->nread > 0) {
+    pru_read_block(2, l->w, l->nwords);
+  }
+}
@@ -0,0 +1,363 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+#include "cblas.h"
+#include <lapacke.h>
+
+#include "matrix_utils.h"
+#include "subspace.h"
+
+//===========================================================
+// This file holds the fcns which split the covariance matrix
+// into signal and noise subspaces.  The general path is the
+// LAPACK SVD called from main.c.  The fcns here exploit structure
+// in the covariance to avoid the full O(M^3) decomposition.
+
+
+//-----------------------------------------------------
+void rank1_basis(const float *v, int M, float *U, float *S) {
+  // When the covariance is the single outer product Rxx = v*v',
+  // its SVD is known in closed form:  the only nonzero singular
+  // value is ||v||^2 with singular vector u = v/||v||, and any
+  // orthonormal basis of the complement of u will do for the
+  // rest.  The Householder reflector
+  //   H = I - 2*w*w'/(w'*w),  w = u + sign(u_0)*e_1
+  // maps e_1 to -sign(u_0)*u, so its columns are exactly such a
+  // basis.  We write H into U (row-major, [M, M]) and the singular
+  // values into S, which is what LAPACKE_sgesvd would have given
+  // us up to the choice of basis for the null space.  Cost is
+  // O(M^2) with no SVD at all.
+  int i, j;
+  float nrm, s, u0, scale;
+  float w[M];
+
+  for (i = 0; i < M; i++) {
+    S[i] = 0.0f;
+  }
+
+  nrm = cblas_snrm2(M, v, 1);
+  if (nrm == 0.0f) {
+    // Silence.  Every direction is noise, so any basis will do.
+    for (i = 0; i < M; i++) {
+      for (j = 0; j < M; j++) {
+        U[lindex(M, M, i, j)] = (i == j) ? 1.0f : 0.0f;
+      }
+    }
+    return;
+  }
+  S[0] = nrm*nrm;
+
+  // w = u + sign(u_0)*e_1.  Choosing the sign this way avoids
+  // cancellation in w_0.
+  for (i = 0; i < M; i++) {
+    w[i] = v[i]/nrm;
+  }
+  u0 = w[0];
+  s = (u0 >= 0.0f) ? 1.0f : -1.0f;
+  w[0] = u0 + s;
+
+  // w'*w = 2*(1 + |u_0|)
+  scale = 1.0f/(1.0f + fabsf(u0));
+  for (i = 0; i < M; i++) {
+    for (j = 0; j < M; j++) {
+      U[lindex(M, M, i, j)] = ((i == j) ? 1.0f : 0.0f) - scale*w[i]*w[j];
+    }
+  }
+}
+
+
+//-----------------------------------------------------
+int eig_subspace(float *R, int M, int P, int signal, float *V, float *w, int *isuppz) {
+  // Rxx is symmetric positive semidefinite, so its SVD is just its
+  // eigendecomposition.  Rather than computing all of U and VT
+  // with sgesvd, ask the symmetric range eigensolver for only the
+  // eigenvectors MUSIC will use:
+  //   signal != 0:  the P largest, V is [M, P]
+  //   signal == 0:  the M-P smallest (noise), V is [M, M-P]
+  // V comes back in the same row-major layout extract_signal_vectors
+  // and extract_noise_vectors produce, so it can be used directly.
+  // Columns are in ascending order of eigenvalue, which the MUSIC
+  // sums don't care about.  Only the upper triangle of R is read,
+  // and R is destroyed.  w must hold M floats, isuppz 2*M ints.
+  // Returns the LAPACK info code.
+  int il, iu, nfound, info;
+
+  if (signal) {
+    il = M-P+1;
+    iu = M;
+  } else {
+    il = 1;
+    iu = M-P;
+  }
+
+  info = LAPACKE_ssyevr(LAPACK_ROW_MAJOR, 'V', 'I', 'U',
+                        M, R, M,
+                        0.0f, 0.0f,      /* vl, vu unused for range 'I' */
+                        il, iu,
+                        0.0f,            /* abstol, use default */
+                        &nfound, w,
+                        V, iu-il+1,      /* ldz = number of columns */
+                        isuppz);
+  return info;
+}
+
+
+//-----------------------------------------------------
+int opast_init(opast_ws *ow, int M, int P, float beta) {
+  // Allocate workspace for tracking a P dimensional signal subspace
+  // of length-M snapshots with forgetting factor beta (0 < beta <= 1).
+  // Call opast_reset before the first opast_frame.  Returns 0 on
+  // success, -1 if malloc fails.
+  ow->M = M;
+  ow->P = P;
+  ow->beta = beta;
+  ow->W = (float*) malloc(M*P*sizeof(float));
+  ow->Z = (float*) malloc(P*P*sizeof(float));
+  ow->y = (float*) malloc(P*sizeof(float));
+  ow->q = (float*) malloc(P*sizeof(float));
+  ow->p = (float*) malloc(M*sizeof(float));
+  if (!ow->W || !ow->Z || !ow->y || !ow->q || !ow->p) {
+    opast_free(ow);
+    return -1;
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------
+void opast_free(opast_ws *ow) {
+  free(ow->W);
+  free(ow->Z);
+  free(ow->y);
+  free(ow->q);
+  free(ow->p);
+  ow->W = ow->Z = ow->y = ow->q = ow->p = NULL;
+}
+
+
+//-----------------------------------------------------
+void opast_reset(opast_ws *ow, const float *W, const float *lambda) {
+  // Restart the tracker from a full decomposition.  W is the
+  // [M, P] matrix of signal eigenvectors and lambda the matching
+  // eigenvalues, e.g. straight out of eig_subspace.  Z is the
+  // inverse of the exponentially weighted correlation of the
+  // projections y = W'*x.  In steady state that correlation is
+  // diag(lambda)/(1-beta), so start Z there.
+  int i, j;
+  int P = ow->P;
+  float lam;
+
+  for (i = 0; i < ow->M*P; i++) {
+    ow->W[i] = W[i];
+  }
+  for (i = 0; i < P; i++) {
+    for (j = 0; j < P; j++) {
+      ow->Z[lindex(P, P, i, j)] = 0.0f;
+    }
+    lam = (lambda[i] > FLT_MIN) ? lambda[i] : FLT_MIN;
+    if (ow->beta < 1.0f) {
+      ow->Z[lindex(P, P, i, i)] = (1.0f - ow->beta)/lam;
+    } else {
+      ow->Z[lindex(P, P, i, i)] = 1.0f/lam;   // No forgetting
+    }
+  }
+}
+
+
+//-----------------------------------------------------
+float opast_frame(opast_ws *ow, const float *v, int N) {
+  // Run the orthonormal PAST (OPAST) update of Abed-Meraim, Chkeif
+  // and Hua over every length-M snapshot x = v[k .. k+M-1] of the
+  // N sample buffer v.  For each snapshot:
+  //   y  = W'*x
+  //   q  = Z*y/beta
+  //   g  = 1/(1 + y'*q)
+  //   p  = g*(x - W*y)
+  //   Z  = Z/beta - g*q*q'
+  //   t  = (1/sqrt(1 + |p|^2*|q|^2) - 1)/|q|^2
+  //   p' = t*W*q + (1 + t*|q|^2)*p
+  //   W  = W + p'*q'
+  // which keeps W orthonormal and costs O(M*P) per snapshot instead
+  // of the O(M^3) decomposition.
+  //
+  // Returns the fraction of the frame's energy that fell outside
+  // the tracked subspace, sum(|x|^2 - |y|^2)/sum(|x|^2).  A jump in
+  // this is the caller's cue that the subspace has moved and a full
+  // decomposition is needed.
+  int i, j, k;
+  int M = ow->M;
+  int P = ow->P;
+  int K = N-M+1;
+  float beta = ow->beta;
+  float g, t, qq, pp, xx, yy;
+  float etot = 0.0f;
+  float eout = 0.0f;
+  const float *x;
+
+  for (k = 0; k < K; k++) {
+    x = &v[k];
+
+    // y = W'*x
+    cblas_sgemv(CblasRowMajor, CblasTrans, M, P, 1.0f, ow->W, P, x, 1, 0.0f, ow->y, 1);
+    xx = cblas_sdot(M, x, 1, x, 1);
+    yy = cblas_sdot(P, ow->y, 1, ow->y, 1);
+    etot = etot + xx;
+    eout = eout + (xx - yy);
+
+    // q = Z*y/beta
+    cblas_sgemv(CblasRowMajor, CblasNoTrans, P, P, 1.0f/beta, ow->Z, P, ow->y, 1, 0.0f, ow->q, 1);
+    g = 1.0f/(1.0f + cblas_sdot(P, ow->y, 1, ow->q, 1));
+
+    // p = g*(x - W*y)
+    for (i = 0; i < M; i++) {
+      ow->p[i] = x[i];
+    }
+    cblas_sgemv(CblasRowMajor, CblasNoTrans, M, P, -1.0f, ow->W, P, ow->y, 1, 1.0f, ow->p, 1);
+    cblas_sscal(M, g, ow->p, 1);
+
+    // Z = Z/beta - g*q*q'.  Any antisymmetric roundoff in Z grows
+    // like 1/beta^k, since the rank one update never damps it, so
+    // only compute the upper triangle and mirror it.
+    for (i = 0; i < P; i++) {
+      for (j = i; j < P; j++) {
+        ow->Z[lindex(P, P, i, j)] = ow->Z[lindex(P, P, i, j)]/beta - g*ow->q[i]*ow->q[j];
+        ow->Z[lindex(P, P, j, i)] = ow->Z[lindex(P, P, i, j)];
+      }
+    }
+
+    // Orthonormalizing correction
+    qq = cblas_sdot(P, ow->q, 1, ow->q, 1);
+    if (qq == 0.0f) {
+      continue;
+    }
+    pp = cblas_sdot(M, ow->p, 1, ow->p, 1);
+    t = (1.0f/sqrtf(1.0f + pp*qq) - 1.0f)/qq;
+    cblas_sscal(M, 1.0f + t*qq, ow->p, 1);
+    cblas_sgemv(CblasRowMajor, CblasNoTrans, M, P, t, ow->W, P, ow->q, 1, 1.0f, ow->p, 1);
+
+    // W = W + p'*q'
+    cblas_sger(CblasRowMajor, M, P, 1.0f, ow->p, 1, ow->q, 1, ow->W, P);
+  }
+
+  if (etot == 0.0f) {
+    return 0.0f;
+  }
+  return eout/etot;
+}
+
+
+//-----------------------------------------------------
+float opast_residual(opast_ws *ow, const float *v, int N) {
+  // The same energy fraction opast_frame returns, measured against
+  // the current basis W without updating it.  Use this right after
+  // opast_reset, to get the baseline residual of the frame the
+  // basis was just computed from without feeding that frame to
+  // the tracker a second time.
+  int k;
+  int M = ow->M;
+  int P = ow->P;
+  int K = N-M+1;
+  float xx, yy;
+  float etot = 0.0f;
+  float eout = 0.0f;
+  const float *x;
+
+  for (k = 0; k < K; k++) {
+    x = &v[k];
+    cblas_sgemv(CblasRowMajor, CblasTrans, M, P, 1.0f, ow->W, P, x, 1, 0.0f, ow->y, 1);
+    xx = cblas_sdot(M, x, 1, x, 1);
+    yy = cblas_sdot(P, ow->y, 1, ow->y, 1);
+    etot = etot + xx;
+    eout = eout + (xx - yy);
+  }
+
+  if (etot == 0.0f) {
+    return 0.0f;
+  }
+  return eout/etot;
+}
+
+
+//-----------------------------------------------------
+double logdet_loaded(const float *R, int M, float eps, float *A) {
+  // Return log det(R + eps*I) from the Cholesky factor, for the
+  // model order test when we haven't computed all the eigenvalues.
+  // Only the upper triangle of R is read.  A is [M, M] scratch.
+  // The diagonal loading eps keeps a rank-deficient R (e.g. silent
+  // input) from failing the factorization.  Returns -INFINITY if
+  // it fails anyway.
+  int i, j, info;
+  double ld;
+
+  for (i = 0; i < M; i++) {
+    for (j = i; j < M; j++) {
+      A[i*M+j] = R[i*M+j];
+    }
+    A[i*M+i] += eps;
+  }
+  info = LAPACKE_spotrf(LAPACK_ROW_MAJOR, 'U', M, A, M);
+  if (info != 0) {
+    return -INFINITY;
+  }
+  ld = 0.0;
+  for (i = 0; i < M; i++) {
+    ld += 2.0*log(A[i*M+i]);
+  }
+  return ld;
+}
+
+
+//-----------------------------------------------------
+int model_order(int crit, const float *lam, int nlam, int M, int K,
+                float tr, double logdet, float eps) {
+  // Estimate the signal subspace dimension d from the eigenvalues
+  // of the [M, M] covariance, averaged over K snapshots.  lam holds
+  // the nlam largest eigenvalues in descending order, and d is
+  // picked from 0 .. nlam.  We don't need the others individually:
+  // the noise eigenvalues only enter through their arithmetic and
+  // geometric means, which we get from the trace tr and logdet =
+  // log det(R + eps*I) by taking off the signal eigenvalues.
+  //
+  // For each d the criterion is (real data, Wax & Kailath)
+  //   MDL(d) = K/2*(M-d)*log(a/g) + p(d)/2*log(K)
+  //   AIC(d) = K*(M-d)*log(a/g) + 2*p(d)
+  // with a, g the arithmetic and geometric means of the M-d
+  // smallest eigenvalues and p(d) = d*(2M-d+1)/2 free parameters.
+  // MDL is consistent; AIC tends to overestimate d.  Every
+  // eigenvalue gets the same loading eps as logdet.  Returns the
+  // d which minimizes the criterion, or 0 if there is no energy.
+  int d, dbest, q;
+  double st, sl, a, lg, p, cr, cbest;
+
+  if (tr <= 0.0f) {
+    return 0;
+  }
+  if (logdet == -INFINITY) {
+    return nlam;
+  }
+  dbest = 0;
+  cbest = INFINITY;
+  st = tr + M*eps;
+  sl = logdet;
+  for (d = 0; d <= nlam; d++) {
+    if (d > 0) {
+      st -= lam[d-1] + eps;
+      sl -= log(lam[d-1] + eps);
+    }
+    q = M-d;
+    a = st/q;
+    lg = sl/q;
+    p = 0.5*d*(2.0*M-d+1);
+    if (crit == ORDER_AIC) {
+      cr = K*q*(log(a) - lg) + 2.0*p;
+    } else {
+      cr = 0.5*K*q*(log(a) - lg) + 0.5*p*log(K);
+    }
+    if (cr < cbest) {
+      cbest = cr;
+      dbest = d;
+    }
+  }
+  return dbest;
+}
@@ -0,0 +1,22 @@
+#include <time.h>
+#include "timer.h"
+
+//===========================================================
+// Tiny wrappers around the monotonic clock used to report how
+// long the different stages of the main loop take.
+
+
+//-----------------------------------------------------
+void timer_start(struct timespec *t) {
+  clock_gettime(CLOCK_MONOTONIC, t);
+}
+
+
+//-----------------------------------------------------
+float timer_elapsed_us(const struct timespec *t) {
+  // Return microseconds elapsed since timer_start(t).
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - t->tv_sec)*1.0e6f + (now.tv_nsec - t->tv_nsec)*1.0e-3f;
+}
@@ -0,0 +1,275 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "cblas.h"
+
+#include "fft.h"
+#include "toeplitz.h"
+
+//===========================================================
+// This file holds the Toeplitz covariance path.  For stationary
+// input Rxx is Toeplitz, T(i,j) = r_|i-j|, so the M autocorrelation
+// lags r_0 .. r_{M-1} carry all of it.  I estimate them with the
+// biased estimator
+//   r_k = (1/N) sum_i v_i*v_{i+k}
+// which always gives a positive semidefinite T, then find the
+// eigenvector of T's smallest eigenvalue (Pisarenko's noise
+// vector) with Levinson recursions on T - sigma*I, following
+// Cybenko and Van Loan.  Each recursion is O(M^2) and needs no
+// matrix at all, against O(M^3) for the SVD of the [M, M] Rxx.
+
+
+//-----------------------------------------------------
+int toep_init(toep_ws *tw, int N, int M) {
+  // Set up workspace for frames of N samples and M lags.  Returns 0
+  // on success, -1 on bad args or failed malloc.
+  int n;
+
+  tw->p.tw_re = NULL;
+  tw->p.tw_im = NULL;
+  tw->p.rev = NULL;
+  tw->p.re = NULL;
+  tw->p.im = NULL;
+  tw->x = NULL;
+  tw->Xr = NULL;
+  tw->Xi = NULL;
+  tw->r = NULL;
+  tw->a = NULL;
+  tw->b = NULL;
+  tw->niter = 0;
+
+  if ((M < 2) || (M > N)) {
+    printf("toep_init: need 2 <= M <= N, got N = %d, M = %d\n", N, M);
+    return -1;
+  }
+  tw->N = N;
+  tw->M = M;
+
+  // Circular correlation of the zero padded frame gives the linear
+  // one for lags below M as long as n >= N+M-1.  The direct sum
+  // takes about 2*N*M flops, each real FFT about 2.5*n*log2(n).
+  for (n = 4; n < N+M-1; n *= 2) ;
+  tw->use_fft = (2.0f*N*M > TOEP_FFT_RATIO*5.0f*n*log2f(n));
+
+  if (tw->use_fft) {
+    if (fft_init(&tw->p, n) != 0) {
+      return -1;
+    }
+    tw->x = (float*) malloc(n*sizeof(float));
+    tw->Xr = (float*) malloc((n/2+1)*sizeof(float));
+    tw->Xi = (float*) malloc((n/2+1)*sizeof(float));
+  }
+  tw->r = (double*) malloc(M*sizeof(double));
+  tw->a = (double*) malloc(M*sizeof(double));
+  tw->b = (double*) malloc(M*sizeof(double));
+  if ((tw->use_fft && (!tw->x || !tw->Xr || !tw->Xi)) ||
+      !tw->r || !tw->a || !tw->b) {
+    toep_free(tw);
+    return -1;
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------
+void toep_free(toep_ws *tw) {
+  if (tw->use_fft) {
+    fft_free(&tw->p);
+  }
+  free(tw->x);
+  free(tw->Xr);
+  free(tw->Xi);
+  free(tw->r);
+  free(tw->a);
+  free(tw->b);
+  tw->x = NULL;
+  tw->Xr = NULL;
+  tw->Xi = NULL;
+  tw->r = NULL;
+  tw->a = NULL;
+  tw->b = NULL;
+}
+
+
+//-----------------------------------------------------
+void toep_lags(toep_ws *tw, const float *v, float *r) {
+  // Biased autocorrelation lags r[0 .. M-1] of the N samples in v.
+  // Either M dot products, O(N*M), or for long frames the inverse
+  // transform of the power spectrum, O(n*log(n)).  The power
+  // spectrum is real and even, so its forward transform is n times
+  // its inverse and fft_real does both passes.
+  int N = tw->N;
+  int M = tw->M;
+  int n;
+  int k;
+
+  if (!tw->use_fft) {
+    for (k = 0; k < M; k++) {
+      r[k] = cblas_sdot(N-k, v, 1, &v[k], 1)/N;
+    }
+    return;
+  }
+
+  // The FFT plan is only set up when use_fft is.
+  n = tw->p.n;
+  for (k = 0; k < N; k++) {
+    tw->x[k] = v[k];
+  }
+  for (k = N; k < n; k++) {
+    tw->x[k] = 0.0f;
+  }
+  fft_real(&tw->p, tw->x, tw->Xr, tw->Xi);
+
+  for (k = 0; k <= n/2; k++) {
+    tw->x[k] = tw->Xr[k]*tw->Xr[k] + tw->Xi[k]*tw->Xi[k];
+  }
+  for (k = 1; k < n/2; k++) {
+    tw->x[n-k] = tw->x[k];
+  }
+  fft_real(&tw->p, tw->x, tw->Xr, tw->Xi);
+
+  for (k = 0; k < M; k++) {
+    r[k] = tw->Xr[k]/((float) n*N);
+  }
+}
+
+
+//-----------------------------------------------------
+static int levinson(const double *r, int M, double sigma, double *a, double *err) {
+  // Levinson-Durbin on the Toeplitz matrix T - sigma*I.  a[0 .. M-1]
+  // is the prediction error filter, a[0] = 1, which solves
+  //   (T - sigma*I)*a = err*e1
+  // The matrix is positive definite exactly when every prediction
+  // error is positive, and then this returns 0.  If only the last
+  // one isn't, sigma lies between the smallest eigenvalue of T and
+  // that of its leading [M-1, M-1] block, a and err are still
+  // good, and this returns 1.  Otherwise it gives up early and
+  // returns -1.  The filter update is symmetric in a[i] and a[k-i],
+  // so it is done in place in pairs.
+  int i, k;
+  double e, acc, kk, ai, aj;
+
+  e = r[0] - sigma;
+  if (e <= 0.0) {
+    return -1;
+  }
+  a[0] = 1.0;
+  for (k = 1; k < M; k++) {
+    acc = r[k];
+    for (i = 1; i < k; i++) {
+      acc += a[i]*r[k-i];
+    }
+    kk = -acc/e;
+    for (i = 1; 2*i < k; i++) {
+      ai = a[i];
+      aj = a[k-i];
+      a[i] = ai + kk*aj;
+      a[k-i] = aj + kk*ai;
+    }
+    if ((k % 2) == 0) {
+      a[k/2] += kk*a[k/2];
+    }
+    a[k] = kk;
+    e *= (1.0 - kk*kk);
+    if ((e <= 0.0) && (k < M-1)) {
+      return -1;
+    }
+  }
+  *err = e;
+  return (e > 0.0) ? 0 : 1;
+}
+
+
+//-----------------------------------------------------
+float toep_pisarenko(toep_ws *tw, const float *r, float *d) {
+  // Find the smallest eigenvalue of the Toeplitz matrix with lags
+  // r, and its eigenvector d (unit length, [M, 1]).  Returns the
+  // eigenvalue.
+  //
+  // T - sigma*I is positive definite for all sigma below the
+  // smallest eigenvalue lam, and not above it, which Levinson
+  // tells us for O(M^2).  Below lam the final prediction error is
+  //   E(sigma) = 1/(e1'*(T - sigma*I)^-1*e1)
+  // which falls through 0 at lam with slope -||a||^2.  E is concave
+  // there, so a Newton step from below lands past lam and the secant
+  // from there back to the last point below lands short of it.
+  // Alternating the two closes the bracket [lo, hi] from both
+  // sides, with bisection as the fallback when a step lands so far
+  // past that E can't be evaluated.  The filter a is
+  // (T - sigma*I)^-1*e1 scaled, i.e. one step of inverse iteration
+  // with shift sigma, so at convergence it is the eigenvector.
+  int M = tw->M;
+  int k;
+  int info, have_ehi;
+  double lo, hi, s, e, ehi, enew, nrm;
+  double *a = tw->a;
+  double *b = tw->b;
+  double *t;
+
+  for (k = 0; k < M; k++) {
+    tw->r[k] = r[k];
+  }
+  tw->niter = 0;
+
+  // Silent input.  Any vector is an eigenvector.
+  if (tw->r[0] <= 0.0) {
+    for (k = 0; k < M; k++) {
+      d[k] = 0.0f;
+    }
+    d[0] = 1.0f;
+    return 0.0f;
+  }
+
+  // lam can't exceed the diagonal.  Roundoff can leave T itself
+  // just short of positive definite, in which case start from a
+  // slightly negative shift.
+  hi = tw->r[0];
+  ehi = 0.0;
+  have_ehi = 0;
+  lo = 0.0;
+  while (levinson(tw->r, M, lo, a, &e) != 0) {
+    tw->niter++;
+    if (tw->niter >= TOEP_MAXITER) {
+      // Lags that aren't a covariance at all.  Give up the same way
+      // as for silence.
+      for (k = 0; k < M; k++) {
+        d[k] = 0.0f;
+      }
+      d[0] = 1.0f;
+      return 0.0f;
+    }
+    lo = (lo == 0.0) ? -TOEP_TOL*hi : 2.0*lo;
+  }
+  tw->niter++;
+
+  while ((tw->niter < TOEP_MAXITER) && (hi - lo > TOEP_TOL*hi)) {
+    if (have_ehi) {
+      s = lo + e*(hi - lo)/(e - ehi);
+    } else {
+      s = lo + e/cblas_ddot(M, a, 1, a, 1);
+    }
+    if ((s <= lo) || (s >= hi)) {
+      s = 0.5*(lo + hi);
+    }
+    tw->niter++;
+    info = levinson(tw->r, M, s, b, &enew);
+    if (info == 0) {
+      lo = s;
+      e = enew;
+      t = a;
+      a = b;
+      b = t;
+      have_ehi = 0;
+    } else {
+      hi = s;
+      ehi = enew;
+      have_ehi = (info == 1) && (enew < 0.0);
+    }
+  }
+
+  nrm = sqrt(cblas_ddot(M, a, 1, a, 1));
+  for (k = 0; k < M; k++) {
+    d[k] = a[k]/nrm;
+  }
+  return (float) lo;
+}
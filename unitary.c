@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+#include "cblas.h"
+#include <lapacke.h>
+
+#include "matrix_utils.h"
+#include "music.h"
+#include "unitary.h"
+
+//===========================================================
+// This file holds real-valued (unitary) MUSIC.  Our samples are
+// real, so after forward-backward averaging Rxx is centro-
+// symmetric:  Rxx = J*Rxx*J.  The eigenvectors of such a matrix
+// are either symmetric, [x; J*x], or antisymmetric, [x; -J*x], and
+// the x's are eigenvectors of two [M/2, M/2] real symmetric
+// matrices Ep and Em.  Two half-size eigenproblems cost about a
+// quarter of one full size one.
+//
+// The search uses the same split.  With the steering vector
+// centred on the middle of the snapshot,
+//   e(w)_n = exp(j*w*(n - (M-1)/2))
+// the real part is symmetric and the imag part antisymmetric, so
+// the symmetric signal vectors only see the cos half and the
+// antisymmetric ones only the sin half.  The global phase doesn't
+// change |Es'*e|, so the pseudospectrum is the same as before,
+// but each point takes P dot products of length M/2 instead of
+// 2*P of length M.
+
+
+//-----------------------------------------------------
+static float rup(const float *R, int M, int a, int b) {
+  // Element (a, b) of symmetric R when only the upper triangle
+  // is filled in.
+  return (a <= b) ? R[a*M+b] : R[b*M+a];
+}
+
+
+//-----------------------------------------------------
+int unitary_init(unitary_ws *uw, int M, int P) {
+  // Allocate workspace for the unitary decomposition of an [M, M]
+  // covariance with up to P signal vectors.  M must be even.
+  // Returns 0 on success, -1 on bad args or failed malloc.
+  int h;
+
+  if ((M % 2) || (P > M/2)) {
+    printf("unitary_init: need M even and P <= M/2, got M = %d, P = %d\n", M, P);
+    return -1;
+  }
+  h = M/2;
+  uw->M = M;
+  uw->h = h;
+  uw->P = P;
+  uw->np = 0;
+  uw->nm = 0;
+  uw->Ep = (float*) malloc(h*h*sizeof(float));
+  uw->Em = (float*) malloc(h*h*sizeof(float));
+  uw->Xp = (float*) malloc(h*P*sizeof(float));
+  uw->Xm = (float*) malloc(h*P*sizeof(float));
+  uw->wp = (float*) malloc(h*sizeof(float));
+  uw->wm = (float*) malloc(h*sizeof(float));
+  uw->isuppz = (int*) malloc(2*h*sizeof(int));
+  uw->c = (float*) malloc(h*sizeof(float));
+  uw->s = (float*) malloc(h*sizeof(float));
+  uw->y = (float*) malloc(P*sizeof(float));
+  if (!uw->Ep || !uw->Em || !uw->Xp || !uw->Xm || !uw->wp || !uw->wm ||
+      !uw->isuppz || !uw->c || !uw->s || !uw->y) {
+    unitary_free(uw);
+    return -1;
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------
+void unitary_free(unitary_ws *uw) {
+  free(uw->Ep);
+  free(uw->Em);
+  free(uw->Xp);
+  free(uw->Xm);
+  free(uw->wp);
+  free(uw->wm);
+  free(uw->isuppz);
+  free(uw->c);
+  free(uw->s);
+  free(uw->y);
+  uw->Ep = NULL;
+  uw->Em = NULL;
+  uw->Xp = NULL;
+  uw->Xm = NULL;
+  uw->wp = NULL;
+  uw->wm = NULL;
+  uw->isuppz = NULL;
+  uw->c = NULL;
+  uw->s = NULL;
+  uw->y = NULL;
+}
+
+
+//-----------------------------------------------------
+int unitary_subspace(unitary_ws *uw, const float *R, int P, float *Es) {
+  // Find the P dimensional signal subspace of the covariance R
+  // ([M, M], upper triangle only, as from hankel_cov).  With u =
+  // [x; +/-J*x]/sqrt(2),
+  //   u'*R*u = x'*(A + JCJ +/- (B'J + JB))*x/2
+  // where A, B', C are the blocks of R.  These are the Ep and Em
+  // matrices.  Taking them from R directly is the same as forward-
+  // backward averaging R first, so hankel_cov needn't do that.
+  //
+  // We ask each half for its P largest eigenpairs, then keep the P
+  // largest of the 2P.  Their halves go to Xp and Xm for
+  // unitary_grid, and the full length vectors to Es ([M, P],
+  // symmetric ones first) for the other estimators.  Returns the
+  // LAPACK info code.
+  int i, j, k, ip, im, info, nfound;
+  int M = uw->M;
+  int h = uw->h;
+  float a, b;
+
+  for (i = 0; i < h; i++) {
+    for (j = i; j < h; j++) {
+      a = rup(R, M, i, j) + rup(R, M, M-1-i, M-1-j);
+      b = rup(R, M, i, M-1-j) + rup(R, M, M-1-i, j);
+      uw->Ep[i*h+j] = 0.5f*(a + b);
+      uw->Em[i*h+j] = 0.5f*(a - b);
+    }
+  }
+
+  // Eigenvectors come out in ascending order, so the largest is in
+  // the last column.  Park them in Xp and Xm with ldz = P.
+  info = LAPACKE_ssyevr(LAPACK_ROW_MAJOR, 'V', 'I', 'U',
+                        h, uw->Ep, h,
+                        0.0f, 0.0f, h-P+1, h, 0.0f,
+                        &nfound, uw->wp, uw->Xp, P, uw->isuppz);
+  if (info != 0) {
+    return info;
+  }
+  info = LAPACKE_ssyevr(LAPACK_ROW_MAJOR, 'V', 'I', 'U',
+                        h, uw->Em, h,
+                        0.0f, 0.0f, h-P+1, h, 0.0f,
+                        &nfound, uw->wm, uw->Xm, P, uw->isuppz);
+  if (info != 0) {
+    return info;
+  }
+
+  // Merge:  walk down both lists of eigenvalues from the top.
+  ip = P-1;
+  im = P-1;
+  for (k = 0; k < P; k++) {
+    if ((im < 0) || ((ip >= 0) && (uw->wp[ip] >= uw->wm[im]))) {
+      ip--;
+    } else {
+      im--;
+    }
+  }
+  uw->np = P-1-ip;
+  uw->nm = P-1-im;
+
+  // Move the chosen columns to the front of Xp and Xm, keeping
+  // row stride P, and build the full length vectors.
+  for (i = 0; i < h; i++) {
+    for (k = 0; k < uw->np; k++) {
+      uw->Xp[i*P+k] = uw->Xp[i*P+ip+1+k];
+      Es[i*P+k] = uw->Xp[i*P+k]*(float) M_SQRT1_2;
+      Es[(M-1-i)*P+k] = Es[i*P+k];
+    }
+    for (k = 0; k < uw->nm; k++) {
+      uw->Xm[i*P+k] = uw->Xm[i*P+im+1+k];
+      Es[i*P+uw->np+k] = uw->Xm[i*P+k]*(float) M_SQRT1_2;
+      Es[(M-1-i)*P+uw->np+k] = -Es[i*P+uw->np+k];
+    }
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------
+void unitary_grid(unitary_ws *uw, float f0, float f1, int N, float *Pmu) {
+  // Signal-subspace pseudospectrum on N equally spaced normalized
+  // frequencies f0 .. f1, using the halves found by
+  // unitary_subspace.  For the symmetric u = [x; J*x]/sqrt(2),
+  // u'*Re(e) = sqrt(2)*x'*c where c is the first half of the
+  // centred cos, and likewise for the antisymmetric ones and sin,
+  // so
+  //   |Es'*e|^2 = 2*(|Xp'*c|^2 + |Xm'*s|^2)
+  // c and s are generated by a rotor recurrence from the start
+  // rotor exp(-j*(M-1)*w/2) and the step exp(j*w).  Both of those
+  // are in turn stepped across the grid by recurrence, as in
+  // steer_grid, so there are only four cos/sin pairs per call.
+  int i, k;
+  int M = uw->M;
+  int h = uw->h;
+  int P = uw->P;
+  double w0, dw, rc, rs, dc, ds, t;
+  double sc, ss, sdc, sds, pc, ps, pdc, pds;
+  float q;
+
+  w0 = 2*PI*f0;
+  dw = 2*PI*(f1-f0)/(N-1);
+  sc = cos(-0.5*(M-1)*w0);
+  ss = sin(-0.5*(M-1)*w0);
+  sdc = cos(-0.5*(M-1)*dw);
+  sds = sin(-0.5*(M-1)*dw);
+  pc = cos(w0);
+  ps = sin(w0);
+  pdc = cos(dw);
+  pds = sin(dw);
+
+  for (k = 0; k < N; k++) {
+    rc = sc;
+    rs = ss;
+    dc = pc;
+    ds = ps;
+    t = sc*sdc - ss*sds;
+    ss = sc*sds + ss*sdc;
+    sc = t;
+    t = pc*pdc - ps*pds;
+    ps = pc*pds + ps*pdc;
+    pc = t;
+    for (i = 0; i < h; i++) {
+      uw->c[i] = (float) rc;
+      uw->s[i] = (float) rs;
+      t = rc*dc - rs*ds;
+      rs = rc*ds + rs*dc;
+      rc = t;
+    }
+
+    q = 0.0f;
+    if (uw->np > 0) {
+      cblas_sgemv(CblasRowMajor, CblasTrans, h, uw->np, 1.0f, uw->Xp, P,
+                  uw->c, 1, 0.0f, uw->y, 1);
+      q += cblas_sdot(uw->np, uw->y, 1, uw->y, 1);
+    }
+    if (uw->nm > 0) {
+      cblas_sgemv(CblasRowMajor, CblasTrans, h, uw->nm, 1.0f, uw->Xm, P,
+                  uw->s, 1, 0.0f, uw->y, 1);
+      q += cblas_sdot(uw->nm, uw->y, 1, uw->y, 1);
+    }
+
+    // Same guard as the complex evaluators:  the subtraction
+    // cancels near the peak.
+    q = M - 2.0f*q;
+    if (q < M*FLT_EPSILON) {
+      q = M*FLT_EPSILON;
+    }
+    Pmu[k] = 1.0f/q;
+  }
+}
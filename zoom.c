@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "cblas.h"
+
+#include "matrix_utils.h"
+#include "music.h"
+#include "zoom.h"
+
+//===========================================================
+// This file holds the zoom front end.  If we know the tone is in
+// [flo, fhi], we mix the input down by fshift with a complex NCO,
+// filter, and keep every D'th sample.  The band then sits in
+// [0, fs/(2D)] at the lower rate, and MUSIC sees the same number
+// of samples spread over D times as long, so it resolves D times
+// finer, or can use a D times shorter snapshot for the same
+// resolution.  Add fshift to the frequencies it finds.
+//
+// The filter is one-sided:  a lowpass prototype modulated up to
+// the middle of the shifted band, so it passes the band but not
+// the negative frequency image the mix also makes.  Its output is
+// then analytic, and the real part is a real signal holding just
+// the shifted band, which is what the rest of the code expects.
+// Since we only want the real part, we only compute that.
+//
+// For a band near DC mixing down gains nothing, since the band
+// has to stay clear of 0 anyway.  Then fshift = 0 and this is a
+// plain lowpass decimator.
+
+
+//-----------------------------------------------------
+int zoom_init(zoom_ws *zw, float fs, float flo, float fhi, int nout, int maxin) {
+  // Set up to zoom into [flo, fhi] Hz of input sampled at fs,
+  // producing nout samples per frame from at most maxin raw
+  // samples.  Picks the largest D which keeps the band plus guard
+  // under the new Nyquist and the frame within maxin, and designs
+  // a Hamming windowed sinc prototype to match.  Returns 0 on
+  // success, -1 on bad args or failed malloc.
+  int j, n, c, D0, D1;
+  float g, fcen, wb, x, sum;
+
+  if ((flo <= 0.0f) || (fhi <= flo) || (fhi > fs/2.0f) || (nout < 2)) {
+    printf("zoom_init: need 0 < flo < fhi <= fs/2, got flo = %f, fhi = %f\n", flo, fhi);
+    return -1;
+  }
+
+  // Without mixing the band occupies [0, fhi+g].  Mixed down by
+  // flo-g it occupies [g, fhi-flo+2g], passband centred at fcen.
+  g = ZOOM_GUARD*(fhi - flo);
+  D0 = (int) (fs/(2.0f*(fhi + g)));
+  D1 = (int) (fs/(2.0f*(fhi - flo + 2.0f*g)));
+  if ((D1 > D0) && (flo > g)) {
+    zw->D = D1;
+    zw->fshift = flo - g;
+    fcen = g + 0.5f*(fhi - flo);
+    wb = 0.5f*(fhi - flo) + 0.5f*g;
+  } else {
+    zw->D = (D0 > 1) ? D0 : 1;
+    zw->fshift = 0.0f;
+    fcen = 0.0f;
+    wb = fhi + 0.5f*g;
+  }
+  while ((zw->D > 1) && (zw->D*(nout-1 + ZOOM_TAPS) + 1 > maxin)) {
+    zw->D--;
+  }
+  zw->ntaps = ZOOM_TAPS*zw->D + 1;
+  zw->nout = nout;
+  zw->nin = zw->D*(nout-1) + zw->ntaps;
+  if (zw->nin > maxin) {
+    printf("zoom_init: need %d samples per frame, only have %d\n", zw->nin, maxin);
+    return -1;
+  }
+
+  zw->hr = (float*) malloc(zw->ntaps*sizeof(float));
+  zw->hi = (float*) malloc(zw->ntaps*sizeof(float));
+  zw->loc = (float*) malloc(zw->nin*sizeof(float));
+  zw->los = (float*) malloc(zw->nin*sizeof(float));
+  zw->xr = (float*) malloc(zw->nin*sizeof(float));
+  zw->xi = (float*) malloc(zw->nin*sizeof(float));
+  if (!zw->hr || !zw->hi || !zw->loc || !zw->los || !zw->xr || !zw->xi) {
+    zoom_free(zw);
+    return -1;
+  }
+
+  // Lowpass prototype with cutoff wb, unit gain at DC, then
+  // modulated to fcen.  zoom_run correlates rather than convolves,
+  // so the taps are h*exp(-j*w*(j-c)) = hr - j*hi.
+  wb = wb/fs;
+  c = (zw->ntaps-1)/2;
+  sum = 0.0f;
+  for (j = 0; j < zw->ntaps; j++) {
+    x = (float) (j - c);
+    zw->hr[j] = (j == c) ? 2.0f*wb : sinf(2*PI*wb*x)/(PI*x);
+    zw->hr[j] *= 0.54f - 0.46f*cosf(2*PI*j/(zw->ntaps-1));
+    sum += zw->hr[j];
+  }
+  for (j = 0; j < zw->ntaps; j++) {
+    x = 2*PI*fcen/fs*(j - c);
+    zw->hi[j] = zw->hr[j]*sinf(x)/sum;
+    zw->hr[j] = zw->hr[j]*cosf(x)/sum;
+  }
+
+  // The NCO is a table.  Each frame is processed on its own, so
+  // the phase restarting at 0 every frame does no harm.
+  for (n = 0; n < zw->nin; n++) {
+    zw->loc[n] = cos(2*PI*(double) zw->fshift*n/fs);
+    zw->los[n] = -sin(2*PI*(double) zw->fshift*n/fs);
+  }
+  return 0;
+}
+
+
+//-----------------------------------------------------
+void zoom_free(zoom_ws *zw) {
+  free(zw->hr);
+  free(zw->hi);
+  free(zw->loc);
+  free(zw->los);
+  free(zw->xr);
+  free(zw->xi);
+  zw->hr = NULL;
+  zw->hi = NULL;
+  zw->loc = NULL;
+  zw->los = NULL;
+  zw->xr = NULL;
+  zw->xi = NULL;
+}
+
+
+//-----------------------------------------------------
+void zoom_run(zoom_ws *zw, const float *x, float *y) {
+  // Mix the nin raw samples in x down and decimate into the nout
+  // samples of y.  The mix is a plain elementwise product with the
+  // NCO tables, which the compiler vectorizes.  The decimator only
+  // computes the outputs we keep, one complex dot product of the
+  // FIR against the input each, which is the polyphase form
+  // without the bookkeeping.  With the taps hr - j*hi (see
+  // zoom_init), y is the real part
+  //   Re((hr - j*hi)*(xr + j*xi)) = hr.xr + hi.xi
+  int n, k;
+  int D = zw->D;
+
+  if (zw->fshift == 0.0f) {
+    for (k = 0; k < zw->nout; k++) {
+      y[k] = cblas_sdot(zw->ntaps, zw->hr, 1, &x[k*D], 1);
+    }
+    return;
+  }
+
+  for (n = 0; n < zw->nin; n++) {
+    zw->xr[n] = zw->loc[n]*x[n];
+    zw->xi[n] = zw->los[n]*x[n];
+  }
+  for (k = 0; k < zw->nout; k++) {
+    y[k] = cblas_sdot(zw->ntaps, zw->hr, 1, &zw->xr[k*D], 1)
+         + cblas_sdot(zw->ntaps, zw->hi, 1, &zw->xi[k*D], 1);
+  }
+}